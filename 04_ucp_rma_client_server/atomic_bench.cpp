@@ -0,0 +1,192 @@
+// Remote atomic latency/throughput benchmark over UcxEndpoint.
+// - Latency: one blocking fetching atomic at a time (post + wait), percentiles
+//   over all iterations.
+// - Throughput: up to `depth` fetching atomics outstanding on one endpoint.
+// The target word lives in a server region, so the counter it leaves behind
+// doubles as a remote sequence generator shared by all clients.
+
+#include "ucx_util.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <unistd.h>
+
+using Clock = std::chrono::steady_clock;
+
+static inline void die(const char* msg) {
+    std::fprintf(stderr, "%s\n", msg);
+    std::exit(1);
+}
+
+enum class AmoOp { FetchAdd, Swap, CompareSwap };
+
+struct BenchOptions {
+    uint32_t region{0};
+    uint64_t offset{0};
+    size_t iters{100000};
+    size_t depth{32};
+    AmoOp op{AmoOp::FetchAdd};
+};
+
+template <typename T>
+class AtomicBench {
+public:
+    AtomicBench(const UcxEnv& env, const UcxEndpoint& ep, uint64_t raddr, ucp_rkey_h rkey, AmoOp op)
+        : env_(env), ep_(ep), raddr_(raddr), rkey_(rkey), op_(op) {}
+
+    // Posts one atomic; *result gets the old remote value. `last` is the last
+    // value observed, used by CAS to chain increments.
+    void* post(T* result, T last, const ucp_request_param_t* param) const {
+        switch (op_) {
+            case AmoOp::FetchAdd: return ep_.fetch_add_nbx<T>(1, result, raddr_, rkey_, param);
+            case AmoOp::Swap: return ep_.swap_nbx<T>(last + 1, result, raddr_, rkey_, param);
+            case AmoOp::CompareSwap: return ep_.compare_swap_nbx<T>(last, last + 1, result, raddr_, rkey_, param);
+        }
+        return nullptr;
+    }
+
+    T read() const {
+        T v = 0;
+        void* req = ep_.fetch_add_nbx<T>(0, &v, raddr_, rkey_);
+        if (UCS_PTR_IS_ERR(req) || env_.wait(req) != UCS_OK) die("atomic read failed");
+        return v;
+    }
+
+    void latency(size_t iters) const {
+        std::vector<double> lat_us;
+        lat_us.reserve(iters);
+        T last = read();
+        size_t cas_ok = 0;
+        for (size_t i = 0; i < iters; ++i) {
+            T result = 0;
+            auto t0 = Clock::now();
+            void* req = post(&result, last, nullptr);
+            if (UCS_PTR_IS_ERR(req) || env_.wait(req) != UCS_OK) die("atomic failed");
+            lat_us.push_back(std::chrono::duration<double, std::micro>(Clock::now() - t0).count());
+            if (op_ == AmoOp::CompareSwap && result == last) ++cas_ok;
+            last = (op_ == AmoOp::CompareSwap && result == last) ? last + 1 : result;
+        }
+        std::sort(lat_us.begin(), lat_us.end());
+        auto pct = [&](double p) { return lat_us[std::min(lat_us.size() - 1, static_cast<size_t>(p * lat_us.size()))]; };
+        double sum = 0;
+        for (double v : lat_us) sum += v;
+        std::printf("[atomic] latency  %zu ops: avg %.2f us, p50 %.2f us, p99 %.2f us, p99.9 %.2f us",
+                    iters, sum / iters, pct(0.50), pct(0.99), pct(0.999));
+        if (op_ == AmoOp::CompareSwap) std::printf(", cas success %zu/%zu", cas_ok, iters);
+        std::printf("\n");
+    }
+
+    void throughput(size_t iters, size_t depth) const {
+        UcxCompletionEngine engine(env_);
+        const ucp_request_param_t p = engine.param();
+        std::vector<T> results(depth);
+        std::vector<size_t> free_slots;
+        for (size_t s = 0; s < depth; ++s) free_slots.push_back(depth - 1 - s);
+        std::unordered_map<uint64_t, size_t> slot_of;
+        T last = read();
+
+        auto reap = [&]() {
+            UcxCompletion c;
+            while (engine.poll(c)) {
+                if (c.status != UCS_OK) die("atomic completion error");
+                auto it = slot_of.find(c.id);
+                last = results[it->second];
+                free_slots.push_back(it->second);
+                slot_of.erase(it);
+            }
+        };
+
+        auto t0 = Clock::now();
+        for (size_t i = 0; i < iters; ++i) {
+            while (free_slots.empty()) {
+                engine.progress();
+                reap();
+            }
+            size_t slot = free_slots.back();
+            free_slots.pop_back();
+            void* req = post(&results[slot], last, &p);
+            if (UCS_PTR_IS_ERR(req)) die("atomic post failed");
+            slot_of[engine.submit(req)] = slot;
+            reap();
+        }
+        if (engine.drain() != UCS_OK) die("atomic completion error");
+        double secs = std::chrono::duration<double>(Clock::now() - t0).count();
+        std::printf("[atomic] throughput %zu ops, depth %zu: %.3f ms, %.3f Mops/s\n", iters, depth, secs * 1e3,
+                    secs > 0 ? iters / secs / 1e6 : 0.0);
+    }
+
+private:
+    const UcxEnv& env_;
+    const UcxEndpoint& ep_;
+    uint64_t raddr_;
+    ucp_rkey_h rkey_;
+    AmoOp op_;
+};
+
+template <typename T>
+static void run(const UcxEnv& env, const UcxEndpoint& ep, uint64_t raddr, ucp_rkey_h rkey, const BenchOptions& opts) {
+    AtomicBench<T> bench(env, ep, raddr, rkey, opts.op);
+    bench.latency(opts.iters);
+    bench.throughput(opts.iters, opts.depth);
+    std::printf("[atomic] remote word now %llu\n", static_cast<unsigned long long>(bench.read()));
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::fprintf(stderr,
+                     "Usage: %s <server_ip> <port> [options]\n"
+                     "  --op=<fadd|swap|cswap>  atomic operation (default fadd)\n"
+                     "  --width=<32|64>         word size in bits (default 64)\n"
+                     "  --iters=<n>             operations per phase (default 100000)\n"
+                     "  --depth=<n>             outstanding ops in the throughput phase (default 32)\n"
+                     "  --region=<id>           server region holding the word (default 0)\n"
+                     "  --offset=<bytes>        word offset inside the region (default 0)\n",
+                     argv[0]);
+        return 1;
+    }
+    const char* ip = argv[1];
+    uint16_t port = static_cast<uint16_t>(std::strtoul(argv[2], nullptr, 10));
+
+    BenchOptions opts;
+    unsigned width = 64;
+    for (int i = 3; i < argc; ++i) {
+        const char* v = nullptr;
+        if ((v = cli::opt_value(argv[i], "--op"))) {
+            if (std::strcmp(v, "fadd") == 0) opts.op = AmoOp::FetchAdd;
+            else if (std::strcmp(v, "swap") == 0) opts.op = AmoOp::Swap;
+            else if (std::strcmp(v, "cswap") == 0) opts.op = AmoOp::CompareSwap;
+            else die("op must be fadd, swap or cswap");
+        } else if ((v = cli::opt_value(argv[i], "--width"))) width = static_cast<unsigned>(std::strtoul(v, nullptr, 10));
+        else if ((v = cli::opt_value(argv[i], "--iters"))) opts.iters = static_cast<size_t>(std::strtoull(v, nullptr, 10));
+        else if ((v = cli::opt_value(argv[i], "--depth"))) opts.depth = static_cast<size_t>(std::strtoull(v, nullptr, 10));
+        else if ((v = cli::opt_value(argv[i], "--region"))) opts.region = static_cast<uint32_t>(std::strtoul(v, nullptr, 10));
+        else if ((v = cli::opt_value(argv[i], "--offset"))) opts.offset = cli::parse_size(v);
+        else die("unknown option");
+    }
+    if (width != 32 && width != 64) die("width must be 32 or 64");
+    if (opts.iters == 0 || opts.depth == 0) die("iters and depth must be >= 1");
+
+    int fd = tcp::connect(ip, port);
+    Handshake hs = Handshake::recv_fd(fd); // fd stays open until exit: the server counts live clients by it
+    const RegionDesc& region = hs.region(opts.region);
+    if (opts.offset % (width / 8) != 0) die("offset must be aligned to the word size");
+    if (opts.offset + width / 8 > region.size) die("offset outside the region");
+
+    UcxEnv env;
+    UcxEndpoint ep(env.worker(), hs.worker_addr);
+    ucp_rkey_h rkey = ep.cached_rkey(region.id, region.rkey);
+    uint64_t raddr = region.remote_addr + opts.offset;
+
+    std::printf("[atomic] region %u offset %llu, %u-bit\n", region.id, static_cast<unsigned long long>(opts.offset),
+                width);
+    if (width == 64) run<uint64_t>(env, ep, raddr, rkey, opts);
+    else run<uint32_t>(env, ep, raddr, rkey, opts);
+    return 0;
+}
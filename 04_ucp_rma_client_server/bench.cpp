@@ -0,0 +1,403 @@
+// RMA latency/bandwidth benchmark for the UcxEndpoint wrapper path.
+// - Sweeps message size x outstanding depth for PUT and GET against one server
+//   region; every op's latency is post -> local completion.
+// - Reports p50/p99/p99.9 latency, bandwidth and message rate per point, as a
+//   table and optionally as JSON for regression tracking.
+// - --path=raw runs the same loop on raw ucp_put_nbx/ucp_get_nbx with a plain
+//   callback, so wrapper overhead shows up as the difference between paths.
+// - --path=pool and --path=map give every op its own local buffer, taken from
+//   a UcxBufferPool or freshly allocated and registered with ucp_mem_map, and
+//   release it on completion; latency then includes getting the buffer.
+
+#include "ucx_buffer_pool.h"
+#include "ucx_util.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+using Clock = std::chrono::steady_clock;
+
+static inline void die(const char* msg) {
+    std::fprintf(stderr, "%s\n", msg);
+    std::exit(1);
+}
+
+struct BenchOptions {
+    bool put{true};
+    bool get{true};
+    bool wrapper{true};
+    bool raw{false};
+    bool pool{false};
+    bool map{false};
+    std::vector<size_t> sizes{8, 64, 512, 4096, 32768, 262144, 1048576};
+    std::vector<size_t> depths{1, 16};
+    size_t iters{10000};
+    size_t warmup{100};
+    uint32_t region{0};
+    std::string json; // "" = none, "-" = stdout
+};
+
+// How each op gets its local buffer and is posted.
+enum class BenchPath {
+    Wrapper, // one registered buffer, UcxEndpoint + UcxCompletionEngine
+    Raw,     // one registered buffer, bare ucp_put_nbx/ucp_get_nbx
+    Pool,    // per-op UcxBufferPool buffer, wrapper calls
+    Map,     // per-op new[] + ucp_mem_map, wrapper calls
+};
+
+static const char* path_name(BenchPath path) {
+    switch (path) {
+    case BenchPath::Wrapper: return "wrapper";
+    case BenchPath::Raw: return "raw";
+    case BenchPath::Pool: return "pool";
+    case BenchPath::Map: return "map";
+    }
+    return "?";
+}
+
+struct BenchPoint {
+    const char* op;
+    const char* path;
+    size_t size;
+    size_t depth;
+    size_t iters;
+    double secs;
+    double p50_us, p99_us, p999_us, avg_us;
+    double mbps;
+    double mops;
+};
+
+static double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    return sorted[std::min(sorted.size() - 1, static_cast<size_t>(p * sorted.size()))];
+}
+
+static double us_since(Clock::time_point t0) {
+    return std::chrono::duration<double, std::micro>(Clock::now() - t0).count();
+}
+
+// Raw UCX path: per-op state passed straight through user_data.
+struct RawOp {
+    Clock::time_point t0;
+    double* lat;
+    size_t* pending;
+    ucs_status_t* status;
+};
+
+static void raw_send_cb(void* request, ucs_status_t status, void* user_data) {
+    RawOp* op = static_cast<RawOp*>(user_data);
+    *op->lat = us_since(op->t0);
+    --*op->pending;
+    if (status != UCS_OK) *op->status = status;
+    ucp_request_free(request);
+}
+
+class RmaBench {
+public:
+    // pool may be null when BenchPath::Pool is never run.
+    RmaBench(const UcxEnv& env, const UcxEndpoint& ep, uint64_t raddr, ucp_rkey_h rkey, char* lbuf, ucp_mem_h memh,
+             UcxBufferPool* pool)
+        : env_(env), ep_(ep), raddr_(raddr), rkey_(rkey), lbuf_(lbuf), memh_(memh), pool_(pool) {}
+
+    BenchPoint run(bool put, BenchPath path, size_t size, size_t depth, size_t iters, size_t warmup) const {
+        const bool raw = (path == BenchPath::Raw);
+        std::vector<double> lat(std::max(iters, warmup));
+        if (warmup) raw ? run_raw(put, size, depth, warmup, lat) : run_wrapper(put, path, size, depth, warmup, lat);
+        lat.assign(iters, 0.0);
+        double secs = raw ? run_raw(put, size, depth, iters, lat) : run_wrapper(put, path, size, depth, iters, lat);
+
+        BenchPoint pt{};
+        pt.op = put ? "put" : "get";
+        pt.path = path_name(path);
+        pt.size = size;
+        pt.depth = depth;
+        pt.iters = iters;
+        pt.secs = secs;
+        double sum = 0;
+        for (double v : lat) sum += v;
+        std::sort(lat.begin(), lat.end());
+        pt.p50_us = percentile(lat, 0.50);
+        pt.p99_us = percentile(lat, 0.99);
+        pt.p999_us = percentile(lat, 0.999);
+        pt.avg_us = iters ? sum / iters : 0;
+        pt.mbps = secs > 0 ? static_cast<double>(size) * iters / secs / 1e6 : 0;
+        pt.mops = secs > 0 ? iters / secs / 1e6 : 0;
+        return pt;
+    }
+
+private:
+    ucp_request_param_t base_param() const {
+        ucp_request_param_t p{};
+        p.op_attr_mask = UCP_OP_ATTR_FIELD_MEMH;
+        p.memh = memh_;
+        return p;
+    }
+
+    // Wrapper path: UcxEndpoint NBX calls tracked by UcxCompletionEngine. The
+    // pool and map paths also take a buffer per op and release it on completion.
+    double run_wrapper(bool put, BenchPath path, size_t size, size_t depth, size_t n, std::vector<double>& lat) const {
+        UcxCompletionEngine engine(env_);
+        const ucp_request_param_t base = base_param();
+        ucp_request_param_t p = engine.param(&base);
+        std::vector<Clock::time_point> posted(n);
+        std::vector<UcxBuffer> pbufs(path == BenchPath::Pool ? n : 0);
+        std::vector<std::unique_ptr<char[]>> mbufs(path == BenchPath::Map ? n : 0);
+        std::vector<UcxMem> mmems(mbufs.size());
+        uint64_t first_id = 0;
+        auto reap = [&]() {
+            UcxCompletion c;
+            while (engine.poll(c)) {
+                if (c.status != UCS_OK) die("rma completion error");
+                size_t i = static_cast<size_t>(c.id - first_id);
+                if (i >= n) continue;
+                lat[i] = us_since(posted[i]);
+                if (!pbufs.empty()) {
+                    pool_->free(pbufs[i]);
+                    pbufs[i] = UcxBuffer();
+                } else if (!mbufs.empty()) {
+                    mmems[i] = UcxMem(); // unregisters before the memory goes
+                    mbufs[i].reset();
+                }
+            }
+        };
+
+        auto t0 = Clock::now();
+        for (size_t i = 0; i < n; ++i) {
+            Clock::time_point tp = Clock::now();
+            char* lbuf = lbuf_;
+            if (path == BenchPath::Pool) {
+                pbufs[i] = pool_->alloc(size);
+                lbuf = static_cast<char*>(pbufs[i].ptr);
+                p.memh = pbufs[i].memh;
+            } else if (path == BenchPath::Map) {
+                mbufs[i].reset(new char[std::max<size_t>(1, size)]);
+                mmems[i] = UcxMem(env_.ctx(), mbufs[i].get(), std::max<size_t>(1, size));
+                lbuf = mbufs[i].get();
+                p.memh = mmems[i].memh();
+            }
+            void* req = put ? ep_.put_nbx(lbuf, size, raddr_, rkey_, &p) : ep_.get_nbx(lbuf, size, raddr_, rkey_, &p);
+            if (UCS_PTR_IS_ERR(req)) die(put ? "ucp_put_nbx failed" : "ucp_get_nbx failed");
+            uint64_t id = engine.submit(req);
+            if (i == 0) first_id = id; // ids are sequential per engine
+            posted[i] = tp;
+            reap();
+            while (engine.pending() >= depth) {
+                engine.progress();
+                reap();
+            }
+        }
+        while (engine.pending() > 0) {
+            engine.progress();
+            reap();
+        }
+        reap();
+        if (put) {
+            const ucp_request_param_t fp = engine.param();
+            void* req = ep_.flush_nbx(&fp);
+            if (UCS_PTR_IS_ERR(req)) die("flush failed");
+            if (engine.wait_all({engine.submit(req)}) != UCS_OK) die("flush completion error");
+        }
+        return std::chrono::duration<double>(Clock::now() - t0).count();
+    }
+
+    // Raw path: ucp_put_nbx/ucp_get_nbx with a bare callback and counter.
+    double run_raw(bool put, size_t size, size_t depth, size_t n, std::vector<double>& lat) const {
+        std::vector<RawOp> ops(n);
+        size_t pending = 0;
+        ucs_status_t status = UCS_OK;
+        ucp_request_param_t p = base_param();
+        p.op_attr_mask |= UCP_OP_ATTR_FIELD_CALLBACK | UCP_OP_ATTR_FIELD_USER_DATA;
+        p.cb.send = raw_send_cb;
+        ucp_worker_h worker = env_.worker();
+        ucp_ep_h ep = ep_.ep();
+
+        auto t0 = Clock::now();
+        for (size_t i = 0; i < n; ++i) {
+            RawOp& op = ops[i];
+            op.lat = &lat[i];
+            op.pending = &pending;
+            op.status = &status;
+            p.user_data = &op;
+            op.t0 = Clock::now();
+            ucs_status_ptr_t req = put ? ucp_put_nbx(ep, lbuf_, size, raddr_, rkey_, &p)
+                                       : ucp_get_nbx(ep, lbuf_, size, raddr_, rkey_, &p);
+            if (req == nullptr) lat[i] = us_since(op.t0);
+            else if (UCS_PTR_IS_ERR(req)) die(put ? "ucp_put_nbx failed" : "ucp_get_nbx failed");
+            else ++pending;
+            while (pending >= depth) ucp_worker_progress(worker);
+        }
+        while (pending > 0) ucp_worker_progress(worker);
+        if (put) {
+            ucp_request_param_t fp{};
+            ucs_status_ptr_t req = ucp_ep_flush_nbx(ep, &fp);
+            if (UCS_PTR_IS_ERR(req)) die("flush failed");
+            if (req != nullptr) {
+                ucs_status_t st;
+                do {
+                    ucp_worker_progress(worker);
+                    st = ucp_request_check_status(req);
+                } while (st == UCS_INPROGRESS);
+                ucp_request_free(req);
+                if (st != UCS_OK) status = st;
+            }
+        }
+        if (status != UCS_OK) die("rma completion error");
+        return std::chrono::duration<double>(Clock::now() - t0).count();
+    }
+
+    const UcxEnv& env_;
+    const UcxEndpoint& ep_;
+    uint64_t raddr_;
+    ucp_rkey_h rkey_;
+    char* lbuf_;
+    ucp_mem_h memh_;
+    UcxBufferPool* pool_;
+};
+
+static void write_json(FILE* f, const std::vector<BenchPoint>& pts) {
+    std::fprintf(f, "[\n");
+    for (size_t i = 0; i < pts.size(); ++i) {
+        const BenchPoint& p = pts[i];
+        std::fprintf(f,
+                     "  {\"op\": \"%s\", \"path\": \"%s\", \"size\": %zu, \"depth\": %zu, \"iters\": %zu, "
+                     "\"secs\": %.6f, \"lat_us\": {\"avg\": %.3f, \"p50\": %.3f, \"p99\": %.3f, \"p99_9\": %.3f}, "
+                     "\"bw_MBps\": %.3f, \"msg_rate_Mops\": %.6f}%s\n",
+                     p.op, p.path, p.size, p.depth, p.iters, p.secs, p.avg_us, p.p50_us, p.p99_us, p.p999_us, p.mbps,
+                     p.mops, i + 1 < pts.size() ? "," : "");
+    }
+    std::fprintf(f, "]\n");
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::fprintf(stderr,
+                     "Usage: %s <server_ip> <port> [options]\n"
+                     "  --ops=<put,get>            operations to sweep (default put,get)\n"
+                     "  --sizes=<s1,s2,...>        message sizes, K/M/G ok (default 8,64,512,4K,32K,256K,1M)\n"
+                     "  --depths=<d1,d2,...>       outstanding ops (default 1,16)\n"
+                     "  --iters=<n>                measured ops per point (default 10000)\n"
+                     "  --warmup=<n>               unmeasured ops per point (default 100)\n"
+                     "  --region=<id>              server region to target (default 0)\n"
+                     "  --path=<p1,p2,...>         wrapper, raw, pool, map; both = wrapper,raw; all (default wrapper)\n"
+                     "  --json=<file|->            also write results as JSON\n",
+                     argv[0]);
+        return 1;
+    }
+    const char* ip = argv[1];
+    uint16_t port = static_cast<uint16_t>(std::strtoul(argv[2], nullptr, 10));
+
+    BenchOptions opts;
+    for (int i = 3; i < argc; ++i) {
+        const char* v = nullptr;
+        if ((v = cli::opt_value(argv[i], "--ops"))) {
+            std::string s = v;
+            opts.put = s.find("put") != std::string::npos;
+            opts.get = s.find("get") != std::string::npos;
+        } else if ((v = cli::opt_value(argv[i], "--sizes"))) opts.sizes = cli::parse_size_list(v);
+        else if ((v = cli::opt_value(argv[i], "--depths"))) opts.depths = cli::parse_size_list(v);
+        else if ((v = cli::opt_value(argv[i], "--iters"))) opts.iters = static_cast<size_t>(std::strtoull(v, nullptr, 10));
+        else if ((v = cli::opt_value(argv[i], "--warmup"))) opts.warmup = static_cast<size_t>(std::strtoull(v, nullptr, 10));
+        else if ((v = cli::opt_value(argv[i], "--region"))) opts.region = static_cast<uint32_t>(std::strtoul(v, nullptr, 10));
+        else if ((v = cli::opt_value(argv[i], "--path"))) {
+            opts.wrapper = opts.raw = opts.pool = opts.map = false;
+            std::string s = v;
+            for (size_t pos = 0; pos <= s.size();) {
+                size_t end = std::min(s.find(',', pos), s.size());
+                std::string item = s.substr(pos, end - pos);
+                pos = end + 1;
+                bool all = (item == "all");
+                if (item == "wrapper" || item == "both" || all) opts.wrapper = true;
+                if (item == "raw" || item == "both" || all) opts.raw = true;
+                if (item == "pool" || all) opts.pool = true;
+                if (item == "map" || all) opts.map = true;
+                if (item != "wrapper" && item != "raw" && item != "pool" && item != "map" && item != "both" && !all)
+                    die("path must be a list of wrapper, raw, pool, map, both or all");
+            }
+        } else if ((v = cli::opt_value(argv[i], "--json"))) opts.json = v;
+        else die("unknown option");
+    }
+    if (!opts.put && !opts.get) die("ops must include put and/or get");
+    if (opts.iters == 0) die("iters must be >= 1");
+    if (opts.sizes.empty() || opts.depths.empty()) die("empty size or depth list");
+    for (size_t d : opts.depths)
+        if (d == 0) die("depths must be >= 1");
+
+    int fd = tcp::connect(ip, port);
+    Handshake hs = Handshake::recv_fd(fd); // fd stays open until exit: the server counts live clients by it
+    const RegionDesc& region = hs.region(opts.region);
+
+    UcxEnv env;
+    UcxEndpoint ep(env.worker(), hs.worker_addr);
+    ucp_rkey_h rkey = ep.cached_rkey(region.id, region.rkey);
+
+    // One registered local buffer as large as the biggest message; every op
+    // uses its start (like ucx_perftest), so results measure transport cost.
+    size_t max_size = *std::max_element(opts.sizes.begin(), opts.sizes.end());
+    std::vector<char> lbuf(std::max<size_t>(1, max_size), 0x5a);
+    UcxMem lmem(env.ctx(), lbuf.data(), lbuf.size());
+
+    // --path=pool draws every op's buffer from a pool whose largest class
+    // fits the biggest message; arenas are added as deep points need them.
+    std::unique_ptr<UcxBufferPool> pool;
+    if (opts.pool) {
+        UcxBufferPool::Config cfg;
+        while (cfg.max_class < max_size) cfg.max_class <<= 1;
+        cfg.arena_bytes = std::max(cfg.arena_bytes, cfg.max_class);
+        cfg.max_arenas = 0;
+        pool.reset(new UcxBufferPool(env.ctx(), cfg));
+    }
+    RmaBench bench(env, ep, region.remote_addr, rkey, lbuf.data(), lmem.memh(), pool.get());
+
+    FILE* out = (opts.json == "-") ? stderr : stdout; // keep stdout clean for JSON
+    std::fprintf(out, "[bench] region %u (%llu bytes), %zu iters per point\n", region.id,
+                 (unsigned long long)region.size, opts.iters);
+    std::fprintf(out, "%-4s %-8s %10s %6s %10s %10s %10s %10s %12s %10s\n", "op", "path", "size", "depth", "avg(us)",
+                 "p50(us)", "p99(us)", "p99.9(us)", "MB/s", "Mmsg/s");
+
+    std::vector<BenchPoint> pts;
+    for (int o = 0; o < 2; ++o) {
+        bool put = (o == 0);
+        if ((put && !opts.put) || (!put && !opts.get)) continue;
+        for (size_t size : opts.sizes) {
+            if (size > region.size) {
+                std::fprintf(stderr, "[bench] skipping size %zu: larger than region %u\n", size, region.id);
+                continue;
+            }
+            for (size_t depth : opts.depths) {
+                const bool enabled[] = {opts.wrapper, opts.raw, opts.pool, opts.map};
+                for (int r = 0; r < 4; ++r) {
+                    if (!enabled[r]) continue;
+                    BenchPoint p = bench.run(put, static_cast<BenchPath>(r), size, depth, opts.iters, opts.warmup);
+                    std::fprintf(out, "%-4s %-8s %10zu %6zu %10.2f %10.2f %10.2f %10.2f %12.2f %10.4f\n", p.op, p.path,
+                                 p.size, p.depth, p.avg_us, p.p50_us, p.p99_us, p.p999_us, p.mbps, p.mops);
+                    pts.push_back(p);
+                }
+            }
+        }
+    }
+
+    if (pool) {
+        UcxBufferPool::Stats st = pool->stats();
+        std::fprintf(out, "[bench] pool: %zu arena(s), %zu bytes registered, %llu refills, %llu spills\n", st.arenas,
+                     st.mapped_bytes, (unsigned long long)st.refills, (unsigned long long)st.spills);
+    }
+
+    if (opts.json == "-") {
+        write_json(stdout, pts);
+    } else if (!opts.json.empty()) {
+        FILE* f = std::fopen(opts.json.c_str(), "w");
+        if (!f) die("cannot open json output");
+        write_json(f, pts);
+        std::fclose(f);
+        std::fprintf(out, "[bench] wrote %zu result(s) to %s\n", pts.size(), opts.json.c_str());
+    }
+    return 0;
+}
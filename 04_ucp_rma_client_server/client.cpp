@@ -1,4 +1,13 @@
 #include "ucx_util.h"
+#include "rma_kv.h"
+#include "rma_queue.h"
+#include "rma_snapshot.h"
+#include "rma_page_cache.h"
+#include "rma_array.h"
+#include "rma_log.h"
+#include "rma_replica.h"
+#include "ucx_region.h"
+#include "ucx_verify.h"
 
 #include <cstdio>
 #include <cstdlib>
@@ -6,7 +15,12 @@
 #include <cstdint>
 #include <string>
 #include <vector>
+#include <chrono>
 #include <algorithm>
+#include <memory>
+#include <random>
+#include <thread>
+#include <unordered_map>
 #include <unistd.h>
 #include <stdexcept>
 
@@ -15,10 +29,561 @@ static inline void die(const char* msg) {
     std::exit(1);
 }
 
+struct ClientOptions {
+    size_t chunk{0}; // bytes per RMA op; 0 = whole buffer in one op
+    size_t depth{1}; // max outstanding RMA ops
+    size_t iters{1}; // repeat the transfer, re-registering through the cache
+    uint32_t region{0}; // target server region id
+    std::string key;    // kvget: key to look up
+    size_t msgs{100000}; // qsend: messages to enqueue
+    size_t msg_size{64}; // qsend: payload bytes per message
+    size_t lanes{1};     // put/get: endpoints the region is striped over
+    bool lane_threads{false}; // one worker + thread per lane instead of one shared worker
+    AllocOptions alloc;  // put/get local buffer: hugepages, NUMA node, init threads
+    bool verify{false};  // put/get: compare per-chunk CRC32C with the server afterwards
+    size_t verify_chunk{1 << 20}; // digest granularity for --verify
+    bool notify{false};  // put: follow every chunk with a put notice to the server
+    PageCacheOptions cache; // pcache: block size, capacity, readahead
+    std::string pattern{"seq"}; // pcache: seq, random or hot (90% of accesses to 10% of the region)
+    size_t accesses{100000};    // pcache: accesses issued
+    size_t access_size{64};     // pcache: bytes per access
+    unsigned write_pct{0};      // pcache: share of accesses that are writes
+    std::vector<std::string> replicas; // replput: host:port of the servers besides the primary
+    size_t quorum{0};           // replput: flushes a write waits for; 0 = majority
+    size_t backlog{16};         // replput: writes a lagging replica may have in flight
+};
+
+// One stripe lane of a put/get transfer: an endpoint to the server, either on
+// the main worker or on its own worker driven by its own thread.
+struct Lane {
+    std::unique_ptr<UcxEnv> env; // set with --lane-threads
+    UcxEndpoint ep;
+    ucp_rkey_h rkey{nullptr};    // owned by ep's rkey cache
+    size_t bytes{0};             // bytes of the region striped onto this lane
+    double secs{0};              // summed over iterations
+};
+
+// Upper bound on idle registrations kept pinned by the client's cache.
+static const size_t kRegCacheBytes = size_t(1) << 30;
+
+// Posts the chunk [off, off+n) of a put/get into reqs and returns how many
+// requests that took. notify_region >= 0 turns puts into put_notify_nbx so the
+// server is told about every chunk it receives: two requests, the put and the
+// notice, both to be tracked. Throws if the put/get could not be posted; a
+// failed notice is left in reqs for the completion engine to report.
+static size_t post_chunk(const UcxEndpoint& ep, bool do_put, long notify_region, char* lbuf, size_t off, size_t n,
+                         uint64_t raddr, ucp_rkey_h rkey, const ucp_request_param_t* p, void* reqs[2]) {
+    size_t count = 1;
+    if (!do_put) {
+        reqs[0] = ep.get_nbx(lbuf + off, n, raddr + off, rkey, p);
+    } else if (notify_region < 0) {
+        reqs[0] = ep.put_nbx(lbuf + off, n, raddr + off, rkey, p);
+    } else {
+        PutNotifyReqs pn =
+            ep.put_notify_nbx(lbuf + off, n, raddr + off, rkey, static_cast<uint32_t>(notify_region), off, p);
+        reqs[0] = pn.put;
+        reqs[1] = pn.notice;
+        count = 2;
+    }
+    if (UCS_PTR_IS_ERR(reqs[0])) throw std::runtime_error(do_put ? "ucp_put_nbx failed" : "ucp_get_nbx failed");
+    return count;
+}
+
+// Transfers the chunk-sized pieces at offsets first, first+stride, ... of
+// [0, len) and keeps up to `depth` of them outstanding (a chunk with a notice
+// is two requests, so the request limit doubles). Completions come back
+// through the completion engine, so a new chunk is posted as soon as any
+// in-flight one finishes. A single endpoint flush at the end makes every chunk
+// remotely visible/complete.
+static void transfer_pipelined(const UcxEnv& env, const UcxEndpoint& ep, bool do_put,
+                               char* lbuf, size_t len, uint64_t raddr, ucp_rkey_h rkey,
+                               const ucp_request_param_t& param, size_t chunk, size_t depth,
+                               size_t first, size_t stride, long notify_region) {
+    UcxCompletionEngine engine(env);
+    const ucp_request_param_t p = engine.param(&param);
+    auto reap = [&]() {
+        UcxCompletion c;
+        while (engine.poll(c))
+            if (c.status != UCS_OK) die(do_put ? "put completion error" : "get completion error");
+    };
+    const size_t max_pending = depth * (notify_region >= 0 ? 2 : 1);
+    for (size_t off = first; off < len; off += stride) {
+        size_t n = std::min(chunk, len - off);
+        void* reqs[2];
+        size_t nreq = post_chunk(ep, do_put, notify_region, lbuf, off, n, raddr, rkey, &p, reqs);
+        for (size_t r = 0; r < nreq; ++r) engine.submit(reqs[r]);
+        while (engine.pending() >= max_pending) engine.progress();
+        reap();
+    }
+    if (engine.drain() != UCS_OK) die(do_put ? "put completion error" : "get completion error");
+    // Ensure remote visibility (PUT) / drain the endpoint (GET)
+    void* req = ep.flush_nbx(&p);
+    if (UCS_PTR_IS_ERR(req)) throw std::runtime_error("flush failed");
+    if (engine.wait_all({engine.submit(req)}) != UCS_OK) die("flush completion error");
+}
+
+// Striped transfer over lanes sharing the main worker: chunk i goes to lane
+// i % K, each lane keeps up to `depth` chunks in flight and is flushed on its
+// own as soon as its last chunk completes, which is when its time is taken.
+static void transfer_striped(const UcxEnv& env, std::vector<Lane>& lanes, bool do_put, char* lbuf, size_t len,
+                             uint64_t raddr, const ucp_request_param_t& param, size_t chunk, size_t depth,
+                             long notify_region) {
+    const size_t k = lanes.size();
+    UcxCompletionEngine engine(env);
+    const ucp_request_param_t p = engine.param(&param);
+    std::unordered_map<uint64_t, size_t> lane_of; // op id -> lane
+    std::vector<size_t> next_off(k), inflight(k, 0);
+    std::vector<bool> flushing(k, false);
+    for (size_t l = 0; l < k; ++l) next_off[l] = l * chunk;
+    const size_t max_inflight = depth * (notify_region >= 0 ? 2 : 1); // requests per lane
+    size_t done = 0;
+
+    auto t0 = std::chrono::steady_clock::now();
+    while (done < k) {
+        for (size_t l = 0; l < k; ++l) {
+            Lane& lane = lanes[l];
+            while (inflight[l] < max_inflight && next_off[l] < len) {
+                size_t off = next_off[l], n = std::min(chunk, len - off);
+                void* reqs[2];
+                size_t nreq = post_chunk(lane.ep, do_put, notify_region, lbuf, off, n, raddr, lane.rkey, &p, reqs);
+                for (size_t r = 0; r < nreq; ++r) lane_of[engine.submit(reqs[r])] = l;
+                inflight[l] += nreq;
+                next_off[l] += k * chunk;
+            }
+            if (next_off[l] >= len && inflight[l] == 0 && !flushing[l]) {
+                void* req = lane.ep.flush_nbx(&p);
+                if (UCS_PTR_IS_ERR(req)) throw std::runtime_error("flush failed");
+                lane_of[engine.submit(req)] = l;
+                ++inflight[l];
+                flushing[l] = true;
+            }
+        }
+        engine.progress();
+        UcxCompletion c;
+        while (engine.poll(c)) {
+            if (c.status != UCS_OK) die(do_put ? "put completion error" : "get completion error");
+            auto it = lane_of.find(c.id);
+            size_t l = it->second;
+            lane_of.erase(it);
+            if (--inflight[l] == 0 && flushing[l]) {
+                lanes[l].secs += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+                ++done;
+            }
+        }
+    }
+}
+
+// Striped transfer with one thread per lane, each progressing its own worker.
+static void transfer_lane_threads(std::vector<Lane>& lanes, bool do_put, char* lbuf, size_t len, uint64_t raddr,
+                                  const ucp_request_param_t& param, size_t chunk, size_t depth,
+                                  long notify_region) {
+    const size_t k = lanes.size();
+    std::vector<std::thread> threads;
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t l = 0; l < k; ++l) {
+        threads.emplace_back([&, l]() {
+            Lane& lane = lanes[l];
+            transfer_pipelined(*lane.env, lane.ep, do_put, lbuf, len, raddr, lane.rkey, param, chunk, depth,
+                               l * chunk, k * chunk, notify_region);
+            lane.secs += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        });
+    }
+    for (std::thread& t : threads) t.join();
+}
+
+// One-sided lookups against a server kv table (server --kv): every iteration
+// resolves `key` with RMA GETs only.
+static void run_kvget(const UcxEnv& env, UcxEndpoint& ep, const RegionDesc& region, const ClientOptions& opts) {
+    RmaKvClient kv(env, ep, ep.cached_rkey(region.id, region.rkey), region);
+    std::string value;
+    bool found = false;
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t it = 0; it < opts.iters; ++it) found = kv.get(opts.key, value);
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    if (found) std::printf("[client] KVGET %s = %s\n", opts.key.c_str(), value.c_str());
+    else std::printf("[client] KVGET %s: not found\n", opts.key.c_str());
+    const RmaKvClient::Stats& st = kv.stats();
+    std::printf("[client] kv region %u (%u buckets): %zu lookup(s), avg %.2f us, %.2f GETs/lookup, %llu retries\n",
+                region.id, kv.nbuckets(), opts.iters, secs * 1e6 / opts.iters,
+                static_cast<double>(st.reads) / st.gets, (unsigned long long)st.retries);
+}
+
+// Seqlock snapshot reads against a server --snapshot area that a writer
+// thread keeps updating: opts.iters reads of opts.chunk bytes (default: the
+// whole area), reporting the retry rate and the effective read bandwidth.
+static void run_snapget(const UcxEnv& env, UcxEndpoint& ep, const RegionDesc& region, const ClientOptions& opts) {
+    RmaSnapshotReader snap(env, ep, ep.cached_rkey(region.id, region.rkey), region);
+    size_t len = (opts.chunk == 0 || opts.chunk > snap.data_len()) ? static_cast<size_t>(snap.data_len()) : opts.chunk;
+    std::vector<char> buf(std::max<size_t>(len, 1));
+    UcxMem mem(env.ctx(), buf.data(), buf.size());
+    uint64_t seq = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t it = 0; it < opts.iters; ++it) seq = snap.read(0, len, buf.data(), mem.memh());
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    const RmaSnapshotReader::Stats& st = snap.stats();
+    uint64_t attempts = st.reads + st.retries;
+    std::printf("[client] SNAPGET region %u: %llu snapshot(s) of %zu bytes, avg %.2f us, %.2f MB/s effective, "
+                "%llu retries (%.2f%% of attempts), last seq %llu\n",
+                region.id, (unsigned long long)st.reads, len, secs * 1e6 / opts.iters,
+                secs > 0 ? st.bytes / secs / 1e6 : 0.0, (unsigned long long)st.retries,
+                attempts ? 100.0 * st.retries / attempts : 0.0, (unsigned long long)seq);
+    std::printf("[client] First 16 bytes: ");
+    for (size_t i = 0; i < std::min<size_t>(16, len); ++i) std::printf("%02x ", (unsigned char)buf[i]);
+    std::printf("\n");
+}
+
+// Far-memory access through a RemotePageCache: opts.accesses reads/writes of
+// opts.access_size bytes following opts.pattern, then a flush of dirty blocks.
+static void run_pcache(const UcxEnv& env, UcxEndpoint& ep, const RegionDesc& region, const ClientOptions& opts) {
+    RemotePageCache cache(env, ep, ep.cached_rkey(region.id, region.rkey), region, opts.cache);
+    size_t size = static_cast<size_t>(region.size);
+    size_t len = std::min(opts.access_size, size);
+    if (len == 0) die("pcache: empty region or access size");
+    size_t span = size - len + 1; // valid start offsets
+    size_t hot = std::max<size_t>(1, span / 10);
+    std::mt19937_64 rng(42);
+    std::vector<char> buf(len);
+
+    size_t seq_off = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < opts.accesses; ++i) {
+        size_t off;
+        if (opts.pattern == "seq") {
+            off = seq_off;
+            seq_off = (seq_off + len < span) ? seq_off + len : 0;
+        } else if (opts.pattern == "hot" && rng() % 10 != 0) {
+            off = rng() % hot;
+        } else {
+            off = rng() % span;
+        }
+        if (rng() % 100 < opts.write_pct) {
+            std::memset(buf.data(), static_cast<int>(i & 0xFF), len);
+            cache.write(off, buf.data(), len);
+        } else {
+            cache.read(off, buf.data(), len);
+        }
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    auto t1 = std::chrono::steady_clock::now();
+    cache.flush();
+    double flush_secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t1).count();
+
+    const RemotePageCache::Stats& st = cache.stats();
+    uint64_t lookups = st.hits + st.misses;
+    std::printf("[client] PCACHE region %u (%s, %zu-byte accesses, %u%% writes): %zu access(es), avg %.3f us\n",
+                region.id, opts.pattern.c_str(), len, opts.write_pct, opts.accesses,
+                opts.accesses ? secs * 1e6 / opts.accesses : 0.0);
+    std::printf("[client] cache: %zu x %zu-byte blocks, hit rate %.2f%% (%llu hits, %llu misses), "
+                "%llu readahead (%llu used), %llu evictions\n",
+                cache.nframes(), cache.block_size(), lookups ? 100.0 * st.hits / lookups : 0.0,
+                (unsigned long long)st.hits, (unsigned long long)st.misses, (unsigned long long)st.readahead,
+                (unsigned long long)st.readahead_hits, (unsigned long long)st.evictions);
+    std::printf("[client] cache: %llu bytes fetched, %llu bytes saved, %llu block(s) written back in %llu batch(es) "
+                "(%llu bytes), final flush %.3f ms\n",
+                (unsigned long long)st.bytes_fetched, (unsigned long long)st.bytes_saved,
+                (unsigned long long)st.writebacks, (unsigned long long)st.writeback_batches,
+                (unsigned long long)st.bytes_written, flush_secs * 1e3);
+}
+
+// RemoteArray<float> over a server region: opts.iters batches of opts.accesses
+// random indices, each fetched once per element (one GET per index in one
+// batch) and once with gather(); the results must match. The gathered values
+// are then scattered back unchanged, so the region keeps its contents.
+static void run_array(const UcxEnv& env, UcxEndpoint& ep, const RegionDesc& region, const ClientOptions& opts) {
+    ucp_rkey_h rkey = ep.cached_rkey(region.id, region.rkey);
+    RemoteArray<float> arr(env, ep, rkey, region);
+    if (arr.size() == 0) die("array: region smaller than one element");
+    size_t n = opts.accesses;
+    std::mt19937_64 rng(42);
+    std::vector<size_t> idx(n);
+    std::vector<float> naive(n);
+    UcxMem naive_mem(env.ctx(), naive.data(), std::max<size_t>(1, n) * sizeof(float));
+
+    double naive_secs = 0, gather_secs = 0, scatter_secs = 0;
+    for (size_t it = 0; it < opts.iters; ++it) {
+        for (size_t& i : idx) i = static_cast<size_t>(rng() % arr.size());
+
+        std::vector<RmaOp> ops(n);
+        for (size_t i = 0; i < n; ++i) {
+            ops[i].laddr = &naive[i];
+            ops[i].raddr = region.remote_addr + idx[i] * sizeof(float);
+            ops[i].len = sizeof(float);
+            ops[i].rkey = rkey;
+        }
+        auto t0 = std::chrono::steady_clock::now();
+        if (ep.get_batch(ops, naive_mem.memh()) != UCS_OK) die("per-element get failed");
+        auto t1 = std::chrono::steady_clock::now();
+        std::vector<float> vals = arr.gather(idx);
+        auto t2 = std::chrono::steady_clock::now();
+        arr.scatter(idx, vals);
+        auto t3 = std::chrono::steady_clock::now();
+        naive_secs += std::chrono::duration<double>(t1 - t0).count();
+        gather_secs += std::chrono::duration<double>(t2 - t1).count();
+        scatter_secs += std::chrono::duration<double>(t3 - t2).count();
+        if (std::memcmp(vals.data(), naive.data(), n * sizeof(float)) != 0) die("gather result differs from per-element GETs");
+    }
+
+    const RemoteArray<float>::Stats& st = arr.stats();
+    double per = static_cast<double>(opts.iters);
+    std::printf("[client] ARRAY region %u: %zu floats, %zu batch(es) of %zu random indices\n", region.id, arr.size(),
+                opts.iters, n);
+    std::printf("[client]   per-element: %zu GETs/batch, %.3f ms/batch\n", n, naive_secs * 1e3 / per);
+    std::printf("[client]   gather/scatter: %.1f ops/batch (%llu bytes/batch incl. gaps <= %zu elems), "
+                "gather %.3f ms/batch, scatter %.3f ms/batch\n",
+                st.ops / (2 * per), (unsigned long long)(st.bytes / (2 * opts.iters)), RemoteArray<float>::kGapElems,
+                gather_secs * 1e3 / per, scatter_secs * 1e3 / per);
+}
+
+// Integrity check after a put/get: both sides digest the region per chunk and
+// the server's digests come back over the handshake connection. Returns the
+// number of mismatching chunks.
+static size_t verify_region(int fd, const RegionDesc& region, const char* lbuf, size_t len, size_t vchunk) {
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<uint32_t> local = chunk_digests(lbuf, len, vchunk);
+    double local_secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    DigestRequest req;
+    req.region = region.id;
+    req.offset = 0;
+    req.len = len;
+    req.chunk = vchunk;
+    auto t1 = std::chrono::steady_clock::now();
+    req.send_fd(fd);
+    DigestReply rep = DigestReply::recv_fd(fd);
+    double rtt_secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t1).count();
+    if (rep.status != DigestReply::kOk) throw std::runtime_error("server rejected digest request");
+    if (rep.digests.size() != local.size()) throw std::runtime_error("digest count mismatch");
+
+    size_t bad = 0;
+    for (size_t i = 0; i < local.size(); ++i) {
+        if (local[i] == rep.digests[i]) continue;
+        if (bad < 8)
+            std::printf("[client]   chunk %zu @ offset %zu: local %08x, server %08x\n", i, i * vchunk, local[i],
+                        rep.digests[i]);
+        ++bad;
+    }
+    std::printf("[client] verify (crc32c %s): %zu chunk(s) of %zu, %zu mismatch(es); local digest %.3f ms "
+                "(%.2f GB/s), server round trip %.3f ms\n",
+                crc32c_impl(), local.size(), vchunk, bad, local_secs * 1e3,
+                local_secs > 0 ? len / local_secs / 1e9 : 0.0, rtt_secs * 1e3);
+    return bad;
+}
+
+// Producer side of the server ring queue (server --queue): enqueues
+// opts.msgs messages of opts.msg_size bytes and reports the message rate.
+static void run_qsend(const UcxEnv& env, UcxEndpoint& ep, const RegionDesc& region, const ClientOptions& opts) {
+    RmaQueueProducer q(env, ep, ep.cached_rkey(region.id, region.rkey), region);
+    if (opts.msg_size > q.max_payload()) die("msg-size exceeds the queue slot payload");
+    std::vector<char> msg(opts.msg_size);
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < opts.msgs; ++i) {
+        std::memset(msg.data(), static_cast<int>(i & 0xFF), msg.size());
+        q.enqueue(msg.data(), msg.size());
+    }
+    q.flush();
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    const RmaQueueProducer::Stats& st = q.stats();
+    std::printf("[client] QSEND region %u (%u slots): %zu msgs of %zu bytes in %.3f ms, %.3f Mmsg/s, %.2f MB/s\n",
+                region.id, q.nslots(), opts.msgs, opts.msg_size, secs * 1e3,
+                secs > 0 ? opts.msgs / secs / 1e6 : 0.0, secs > 0 ? opts.msgs * opts.msg_size / secs / 1e6 : 0.0);
+    std::printf("[client] queue full %llu time(s), %llu remote head read(s)\n", (unsigned long long)st.full_waits,
+                (unsigned long long)st.head_reads);
+}
+
+// Writer side of the server shared log (server --log): appends opts.msgs
+// records of opts.msg_size bytes with up to opts.depth appends in flight.
+// Run several clients at once to have them share the log.
+static void run_logappend(const UcxEnv& env, UcxEndpoint& ep, const RegionDesc& region, const ClientOptions& opts) {
+    uint32_t len = static_cast<uint32_t>(opts.msg_size);
+    RmaLogWriter log(env, ep, ep.cached_rkey(region.id, region.rkey), region, opts.depth, len);
+    std::vector<char> msg(len);
+    const unsigned pid = static_cast<unsigned>(::getpid());
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < opts.msgs; ++i) {
+        // Records carry the writer's pid and sequence so readers can tell them apart
+        std::memset(msg.data(), static_cast<int>(i & 0xFF), msg.size());
+        std::snprintf(msg.data(), msg.size(), "%u:%zu", pid, i);
+        if (!log.append(msg.data(), len)) break;
+    }
+    bool ok = log.flush();
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    const RmaLogWriter::Stats& st = log.stats();
+    std::printf("[client] LOGAPPEND region %u: %llu records of %u bytes in %.3f ms, depth %zu, %.3f Mrec/s, %.2f MB/s%s\n",
+                region.id, (unsigned long long)st.appends, len, secs * 1e3, opts.depth,
+                secs > 0 ? st.appends / secs / 1e6 : 0.0, secs > 0 ? st.bytes / secs / 1e6 : 0.0,
+                ok ? "" : " (log full)");
+}
+
+// Reader side of the server shared log: streams committed records from the
+// start until opts.msgs records were read, the log ends, or nothing new was
+// committed for a second.
+static void run_logread(const UcxEnv& env, UcxEndpoint& ep, const RegionDesc& region, const ClientOptions& opts) {
+    RmaLogReader log(env, ep, ep.cached_rkey(region.id, region.rkey), region);
+    std::string rec;
+    const char* why = "record limit";
+    auto t0 = std::chrono::steady_clock::now();
+    auto last = t0;
+    while (log.stats().records < opts.msgs) {
+        RmaLogReader::Result r = log.next(rec);
+        if (r == RmaLogReader::Result::Record) {
+            last = std::chrono::steady_clock::now();
+        } else if (r == RmaLogReader::Result::End) {
+            why = "end of log";
+            break;
+        } else if (std::chrono::steady_clock::now() - last > std::chrono::seconds(1)) {
+            why = "idle";
+            break;
+        }
+    }
+    double secs = std::chrono::duration<double>(last - t0).count();
+
+    const RmaLogReader::Stats& st = log.stats();
+    std::printf("[client] LOGREAD region %u: %llu records (%llu bytes) in %.3f ms, %.3f Mrec/s, %.2f MB/s, stopped: %s\n",
+                region.id, (unsigned long long)st.records, (unsigned long long)st.bytes, secs * 1e3,
+                secs > 0 ? st.records / secs / 1e6 : 0.0, secs > 0 ? st.bytes / secs / 1e6 : 0.0, why);
+    std::printf("[client] log: %llu window GET(s), %llu tail read(s), %llu CRC retries, cursor %llu\n",
+                (unsigned long long)st.gets, (unsigned long long)st.tail_reads, (unsigned long long)st.retries,
+                (unsigned long long)log.cursor());
+}
+
+struct LatSummary {
+    double avg, p50, p99, max; // microseconds
+};
+
+static LatSummary summarize(std::vector<double> lat) {
+    LatSummary s{0, 0, 0, 0};
+    if (lat.empty()) return s;
+    std::sort(lat.begin(), lat.end());
+    double sum = 0;
+    for (double v : lat) sum += v;
+    s.avg = sum / lat.size();
+    s.p50 = lat[std::min(lat.size() - 1, lat.size() / 2)];
+    s.p99 = lat[std::min(lat.size() - 1, lat.size() * 99 / 100)];
+    s.max = lat.back();
+    return s;
+}
+
+// Replicated writes of `len` bytes (--chunk) to the same region on the
+// primary server and every --replica. First each write goes to the replicas
+// one after another (PUT + flush, wait, next replica), then the same number
+// of writes goes through RmaQuorumWriter, which waits for --quorum flushes
+// only. Prints both latency distributions and per-replica latencies.
+static void run_replput(const UcxEnv& env, UcxEndpoint& ep, const RegionDesc& region, const char* ip, uint16_t port,
+                        size_t len, const ClientOptions& opts) {
+    const size_t n = opts.replicas.size() + 1;
+    const size_t quorum = opts.quorum ? opts.quorum : n / 2 + 1;
+    if (quorum > n) die("quorum larger than the number of replicas");
+
+    // Handshake with every other server and connect to its worker
+    std::vector<std::string> names(1, std::string(ip) + ":" + std::to_string(port));
+    std::vector<Handshake> hss(n);
+    std::vector<UcxEndpoint> eps(n);
+    std::vector<int> fds;
+    for (size_t r = 1; r < n; ++r) {
+        const std::string& hp = opts.replicas[r - 1];
+        size_t colon = hp.rfind(':');
+        if (colon == std::string::npos || colon == 0) die("replica must be host:port");
+        std::string host = hp.substr(0, colon);
+        int fd = tcp::connect(host.c_str(), static_cast<uint16_t>(std::strtoul(hp.c_str() + colon + 1, nullptr, 10)));
+        hss[r] = Handshake::recv_fd(fd);
+        fds.push_back(fd); // open for the run, so the replica counts this client as live
+        eps[r] = UcxEndpoint(env.worker(), hss[r].worker_addr);
+        names.push_back(hp);
+    }
+    std::vector<ReplicaTarget> targets(n);
+    for (size_t r = 0; r < n; ++r) {
+        UcxEndpoint& rep_ep = r == 0 ? ep : eps[r];
+        const RegionDesc& rd = r == 0 ? region : hss[r].region(region.id);
+        if (len > rd.size) die("--chunk is larger than the region on a replica");
+        targets[r].ep = &rep_ep;
+        targets[r].rkey = rep_ep.cached_rkey(rd.id, rd.rkey);
+        targets[r].raddr = rd.remote_addr;
+        targets[r].size = rd.size;
+    }
+
+    std::vector<char> buf(len);
+    for (size_t i = 0; i < len; ++i) buf[i] = static_cast<char>((i * 3) & 0xFF);
+    UcxMem mem(env.ctx(), buf.data(), buf.size());
+
+    // Sequential replication: the write costs the sum of the replica latencies
+    std::vector<double> seq_lat;
+    std::vector<std::vector<double>> seq_rep(n);
+    for (size_t it = 0; it < opts.iters; ++it) {
+        auto t0 = std::chrono::steady_clock::now();
+        for (size_t r = 0; r < n; ++r) {
+            auto r0 = std::chrono::steady_clock::now();
+            RmaOp op;
+            op.laddr = buf.data();
+            op.raddr = targets[r].raddr;
+            op.len = len;
+            op.rkey = targets[r].rkey;
+            if (targets[r].ep->put_batch(std::vector<RmaOp>{op}, mem.memh()) != UCS_OK) die("replica put failed");
+            seq_rep[r].push_back(
+                std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - r0).count());
+        }
+        seq_lat.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count());
+    }
+
+    // Quorum replication: all replicas at once, return after `quorum` flushes
+    RmaQuorumWriter qw(env, targets, quorum, opts.backlog);
+    auto q0 = std::chrono::steady_clock::now();
+    for (size_t it = 0; it < opts.iters; ++it) qw.write(buf.data(), len, 0, mem.memh());
+    double qsecs = std::chrono::duration<double>(std::chrono::steady_clock::now() - q0).count();
+    qw.drain();
+
+    LatSummary s = summarize(seq_lat), q = summarize(qw.quorum_lat_us());
+    std::printf("[client] REPLPUT region %u: %zu replica(s), quorum %zu, %zu write(s) of %zu bytes\n", region.id, n,
+                quorum, opts.iters, len);
+    std::printf("[client]   sequential: avg %.2f us, p50 %.2f us, p99 %.2f us, max %.2f us\n", s.avg, s.p50, s.p99,
+                s.max);
+    std::printf("[client]   quorum:     avg %.2f us, p50 %.2f us, p99 %.2f us, max %.2f us, %.3f Mwrites/s\n", q.avg,
+                q.p50, q.p99, q.max, qsecs > 0 ? opts.iters / qsecs / 1e6 : 0.0);
+    for (size_t r = 0; r < n; ++r) {
+        const RmaQuorumWriter::ReplicaStats& st = qw.stats(r);
+        LatSummary a = summarize(seq_rep[r]), b = summarize(st.lat_us);
+        std::printf("[client]   replica %zu (%s): alone p50 %.2f / p99 %.2f us, concurrent p50 %.2f / p99 %.2f us, "
+                    "in quorum %.1f%%, max lag %llu\n",
+                    r, names[r].c_str(), a.p50, a.p99, b.p50, b.p99,
+                    st.writes ? 100.0 * st.in_quorum / st.writes : 0.0, (unsigned long long)st.max_lag);
+    }
+    for (int fd : fds) ::close(fd);
+}
 
 int main(int argc, char** argv) {
     if (argc < 4) {
-        std::fprintf(stderr, "Usage: %s <server_ip> <port> <put|get>\n", argv[0]);
+        std::fprintf(stderr,
+                     "Usage: %s <server_ip> <port> <put|get|kvget|qsend|snapget|pcache|array|logappend|logread|replput> [options]\n"
+                     "  --chunk=<bytes>   split the transfer into chunks (K/M/G suffix ok);\n"
+                     "                    snapget: bytes per snapshot read (default: whole area)\n"
+                     "  --depth=<n>       max outstanding chunk requests / log appends (default 1)\n"
+                     "  --iters=<n>       repeat the transfer n times (default 1)\n"
+                     "  --region=<id>     server region to target (default 0)\n"
+                     "  --key=<key>       kvget: key to look up in the server's kv table\n"
+                     "  --msgs=<n>        qsend/logappend: messages to send; logread: max records (default 100000)\n"
+                     "  --msg-size=<bytes> qsend/logappend: payload bytes per message (default 64)\n"
+                     "  --cache=<bytes>   pcache: local cache capacity (default 64M)\n"
+                     "  --block=<bytes>   pcache: cache block size (default 4K)\n"
+                     "  --readahead=<n>   pcache: blocks fetched past a sequential miss (default 8)\n"
+                     "  --pattern=<seq|random|hot> pcache: access pattern (default seq)\n"
+                     "  --accesses=<n>    pcache: accesses to issue; array: indices per batch (default 100000)\n"
+                     "  --access-size=<bytes> pcache: bytes per access (default 64)\n"
+                     "  --write-pct=<n>   pcache: percentage of accesses that write (default 0)\n"
+                     "  --lanes=<k>       stripe put/get over k endpoints (default 1)\n"
+                     "  --lane-threads    give every lane its own worker and thread\n"
+                     "  --hugepages=<none|thp|explicit>  back the local buffer with hugepages\n"
+                     "  --numa=<node>     bind the local buffer to a NUMA node\n"
+                     "  --init-threads=<n> threads initializing the local buffer (0 = auto by size)\n"
+                     "  --notify          put: send a notice after every chunk (server reacts without polling)\n"
+                     "  --verify          put/get: compare per-chunk CRC32C with the server afterwards\n"
+                     "  --verify-chunk=<bytes> digest granularity for --verify (default 1M)\n"
+                     "  --replica=<host:port> replput: one more server to replicate to (repeat for each)\n"
+                     "  --quorum=<k>      replput: flushes a write waits for (default: majority)\n"
+                     "  --backlog=<n>     replput: writes a lagging replica may have in flight (default 16)\n",
+                     argv[0]);
         return 1;
     }
     const char* ip = argv[1];
@@ -26,62 +591,190 @@ int main(int argc, char** argv) {
     std::string mode = argv[3];
     bool do_put = (mode == "put");
     bool do_get = (mode == "get");
-    if (!do_put && !do_get) die("mode must be put or get");
+    bool do_kvget = (mode == "kvget");
+    bool do_qsend = (mode == "qsend");
+    bool do_snapget = (mode == "snapget");
+    bool do_pcache = (mode == "pcache");
+    bool do_array = (mode == "array");
+    bool do_logappend = (mode == "logappend");
+    bool do_logread = (mode == "logread");
+    bool do_replput = (mode == "replput");
+    if (!do_put && !do_get && !do_kvget && !do_qsend && !do_snapget && !do_pcache && !do_array && !do_logappend &&
+        !do_logread && !do_replput)
+        die("mode must be put, get, kvget, qsend, snapget, pcache, array, logappend, logread or replput");
 
-    // Fetch handshake
+    ClientOptions opts;
+    for (int i = 4; i < argc; ++i) {
+        const char* v = nullptr;
+        if ((v = cli::opt_value(argv[i], "--chunk"))) opts.chunk = cli::parse_size(v);
+        else if ((v = cli::opt_value(argv[i], "--depth"))) opts.depth = static_cast<size_t>(std::strtoull(v, nullptr, 10));
+        else if ((v = cli::opt_value(argv[i], "--iters"))) opts.iters = static_cast<size_t>(std::strtoull(v, nullptr, 10));
+        else if ((v = cli::opt_value(argv[i], "--region"))) opts.region = static_cast<uint32_t>(std::strtoul(v, nullptr, 10));
+        else if ((v = cli::opt_value(argv[i], "--key"))) opts.key = v;
+        else if ((v = cli::opt_value(argv[i], "--msgs"))) opts.msgs = static_cast<size_t>(std::strtoull(v, nullptr, 10));
+        else if ((v = cli::opt_value(argv[i], "--msg-size"))) opts.msg_size = cli::parse_size(v);
+        else if ((v = cli::opt_value(argv[i], "--lanes"))) opts.lanes = static_cast<size_t>(std::strtoull(v, nullptr, 10));
+        else if (cli::is_flag(argv[i], "--lane-threads")) opts.lane_threads = true;
+        else if ((v = cli::opt_value(argv[i], "--cache"))) opts.cache.capacity = cli::parse_size(v);
+        else if ((v = cli::opt_value(argv[i], "--block"))) opts.cache.block_size = cli::parse_size(v);
+        else if ((v = cli::opt_value(argv[i], "--readahead"))) opts.cache.readahead = static_cast<size_t>(std::strtoull(v, nullptr, 10));
+        else if ((v = cli::opt_value(argv[i], "--pattern"))) opts.pattern = v;
+        else if ((v = cli::opt_value(argv[i], "--accesses"))) opts.accesses = static_cast<size_t>(std::strtoull(v, nullptr, 10));
+        else if ((v = cli::opt_value(argv[i], "--access-size"))) opts.access_size = cli::parse_size(v);
+        else if ((v = cli::opt_value(argv[i], "--write-pct"))) opts.write_pct = static_cast<unsigned>(std::strtoul(v, nullptr, 10));
+        else if (cli::is_flag(argv[i], "--notify")) opts.notify = true;
+        else if (cli::is_flag(argv[i], "--verify")) opts.verify = true;
+        else if ((v = cli::opt_value(argv[i], "--verify-chunk"))) opts.verify_chunk = cli::parse_size(v);
+        else if ((v = cli::opt_value(argv[i], "--replica"))) opts.replicas.push_back(v);
+        else if ((v = cli::opt_value(argv[i], "--quorum"))) opts.quorum = static_cast<size_t>(std::strtoull(v, nullptr, 10));
+        else if ((v = cli::opt_value(argv[i], "--backlog"))) opts.backlog = static_cast<size_t>(std::strtoull(v, nullptr, 10));
+        else if (parse_alloc_option(argv[i], opts.alloc)) continue;
+        else die("unknown option");
+    }
+    if (opts.depth == 0) die("depth must be >= 1");
+    if (opts.iters == 0) die("iters must be >= 1");
+    if (do_kvget && opts.key.empty()) die("kvget needs --key");
+    if (opts.lanes == 0) die("lanes must be >= 1");
+    if (opts.verify_chunk == 0) die("verify-chunk must be >= 1");
+    if (opts.backlog == 0) die("backlog must be >= 1");
+    if (opts.pattern != "seq" && opts.pattern != "random" && opts.pattern != "hot")
+        die("pattern must be seq, random or hot");
+
+    // Fetch handshake. The connection stays open until exit: the server counts
+    // the client as live while it is, and --verify sends digest requests on it.
     int fd = tcp::connect(ip, port);
     Handshake hs = Handshake::recv_fd(fd);
-    ::close(fd);
-    size_t size = static_cast<size_t>(hs.size);
+    bool verify = opts.verify && (do_put || do_get);
+    const RegionDesc& region = hs.region(opts.region);
+    size_t size = static_cast<size_t>(region.size);
+    size_t chunk = (opts.chunk == 0 || opts.chunk > size) ? size : opts.chunk;
+    // Striping without --chunk: one contiguous stripe per lane
+    if (opts.lanes > 1 && chunk == size) chunk = (size + opts.lanes - 1) / opts.lanes;
+    if (chunk == 0) chunk = 1;
+    bool striped = (do_put || do_get) && opts.lanes > 1;
+    long notify_region = (do_put && opts.notify) ? static_cast<long>(region.id) : -1;
 
-    // UCX init
-    UcxEnv env;
+    // UCX init; lane threads add SINGLE-mode workers on the same context
+    UcxEnvOptions env_opts;
+    env_opts.mt_workers_shared = striped && opts.lane_threads;
+    UcxEnv env(env_opts);
 
     // Endpoint to server
     UcxEndpoint ep(env.worker(), hs.worker_addr);
 
-    // Unpack rkey
-    ucp_rkey_h rkey = ep.import_rkey(hs.rkey);
+    if (do_kvget) {
+        run_kvget(env, ep, region, opts);
+        return 0;
+    }
+    if (do_qsend) {
+        run_qsend(env, ep, region, opts);
+        return 0;
+    }
+    if (do_snapget) {
+        run_snapget(env, ep, region, opts);
+        return 0;
+    }
+    if (do_pcache) {
+        run_pcache(env, ep, region, opts);
+        return 0;
+    }
+    if (do_array) {
+        run_array(env, ep, region, opts);
+        return 0;
+    }
+    if (do_logappend) {
+        run_logappend(env, ep, region, opts);
+        return 0;
+    }
+    if (do_logread) {
+        run_logread(env, ep, region, opts);
+        return 0;
+    }
+    if (do_replput) {
+        run_replput(env, ep, region, ip, port, chunk, opts);
+        return 0;
+    }
 
-    // Local buffer and optional registration
-    std::vector<char> lbuf(size);
+    // Local buffer: faulted in (and for PUT filled) by several threads before
+    // registration, optionally on hugepages / a chosen NUMA node
+    RegionMemory lbuf = RegionMemory::anonymous(size, opts.alloc);
     if (do_put) {
-        for (size_t i = 0; i < size; ++i) lbuf[i] = static_cast<char>((i * 3) & 0xFF);
+        lbuf.parallel_init(opts.alloc.init_threads, [](char* p, size_t off, size_t n) {
+            for (size_t i = 0; i < n; ++i) p[i] = static_cast<char>(((off + i) * 3) & 0xFF);
+        });
+    } else {
+        lbuf.prefault(opts.alloc.init_threads);
     }
 
-    UcxMem lmem(env.ctx(), lbuf.data(), lbuf.size());
+    // Registrations go through the pin-down cache, so repeated runs over the
+    // same buffer reuse the first memh instead of calling ucp_mem_map again.
+    UcxRegCache rcache(env.ctx(), kRegCacheBytes);
 
-    // RMA op
-    ucp_request_param_t param{};
-    param.op_attr_mask = UCP_OP_ATTR_FIELD_MEMH; // pass local memh
-    param.memh = lmem.memh();
+    // Striping lanes: every lane has its own endpoint (and rkey unpacked on it);
+    // memh from the shared context is valid on every lane's worker.
+    std::vector<Lane> lanes(striped ? opts.lanes : 0);
+    for (size_t l = 0; l < lanes.size(); ++l) {
+        Lane& lane = lanes[l];
+        ucp_worker_h w = env.worker();
+        if (opts.lane_threads) {
+            UcxEnvOptions wopts;
+            wopts.thread_mode = UCS_THREAD_MODE_SINGLE;
+            lane.env.reset(new UcxEnv(env, wopts));
+            w = lane.env->worker();
+        }
+        lane.ep = UcxEndpoint(w, hs.worker_addr);
+        lane.rkey = lane.ep.cached_rkey(region.id, region.rkey);
+        for (size_t off = l * chunk; off < size; off += lanes.size() * chunk) lane.bytes += std::min(chunk, size - off);
+    }
 
-    void* req = nullptr;
-    ucs_status_t st = UCS_OK;
-    if (do_put) {
-        req = ep.put_nbx(lbuf.data(), lbuf.size(), hs.remote_addr, rkey, &param);
-        if (UCS_PTR_IS_ERR(req)) { UcxEndpoint::destroy_rkey(rkey); throw std::runtime_error("ucp_put_nbx failed"); }
-        st = env.wait(req);
-        if (st != UCS_OK) die("put completion error");
-        // Ensure remote visibility
-        req = ep.flush_nbx(&param);
-        if (UCS_PTR_IS_ERR(req)) { UcxEndpoint::destroy_rkey(rkey); throw std::runtime_error("flush failed"); }
-        st = env.wait(req);
-        if (st != UCS_OK) die("flush completion error");
-    } else {
-        req = ep.get_nbx(lbuf.data(), lbuf.size(), hs.remote_addr, rkey, &param);
-        if (UCS_PTR_IS_ERR(req)) { UcxEndpoint::destroy_rkey(rkey); throw std::runtime_error("ucp_get_nbx failed"); }
-        st = env.wait(req);
-        if (st != UCS_OK) die("get completion error");
+    double secs = 0;
+    for (size_t it = 0; it < opts.iters; ++it) {
+        UcxMem lmem(rcache, lbuf.data(), lbuf.size());
+
+        // Unpacked once; later runs hit the endpoint's rkey cache
+        ucp_rkey_h rkey = ep.cached_rkey(region.id, region.rkey);
+
+        // RMA op
+        ucp_request_param_t param{};
+        param.op_attr_mask = UCP_OP_ATTR_FIELD_MEMH; // pass local memh
+        param.memh = lmem.memh();
+
+        auto t0 = std::chrono::steady_clock::now();
+        if (!striped)
+            transfer_pipelined(env, ep, do_put, lbuf.data(), lbuf.size(), region.remote_addr, rkey, param,
+                               chunk, opts.depth, 0, chunk, notify_region);
+        else if (opts.lane_threads)
+            transfer_lane_threads(lanes, do_put, lbuf.data(), lbuf.size(), region.remote_addr, param, chunk,
+                                  opts.depth, notify_region);
+        else
+            transfer_striped(env, lanes, do_put, lbuf.data(), lbuf.size(), region.remote_addr, param, chunk,
+                             opts.depth, notify_region);
+        secs += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    }
+    secs /= static_cast<double>(opts.iters);
+
+    std::printf("[client] %s region %u: %zu bytes in %zu chunk(s) of %zu, depth %zu, %zu lane(s): %.3f ms, %.2f MB/s (avg of %zu)\n",
+                notify_region >= 0 ? "PUT+notify" : do_put ? "PUT" : "GET", region.id, size, size ? (size + chunk - 1) / chunk : 0, chunk, opts.depth,
+                std::max<size_t>(1, lanes.size()), secs * 1e3, secs > 0 ? size / secs / 1e6 : 0.0, opts.iters);
+    for (size_t l = 0; l < lanes.size(); ++l) {
+        double lsecs = lanes[l].secs / static_cast<double>(opts.iters);
+        std::printf("[client]   lane %zu%s: %zu bytes, %.3f ms, %.2f MB/s\n", l, opts.lane_threads ? " (thread)" : "",
+                    lanes[l].bytes, lsecs * 1e3, lsecs > 0 ? lanes[l].bytes / lsecs / 1e6 : 0.0);
     }
+    UcxRegCache::Stats rst = rcache.stats();
+    std::printf("[client] reg cache: hits=%llu misses=%llu pinned=%zu bytes\n",
+                (unsigned long long)rst.hits, (unsigned long long)rst.misses, rst.pinned_bytes);
 
     // Print first 16 bytes for verification
     std::printf("[client] %s done. First 16 bytes: ", do_put ? "PUT" : "GET");
     for (size_t i = 0; i < std::min<size_t>(16, lbuf.size()); ++i)
-        std::printf("%02x ", (unsigned char)lbuf[i]);
+        std::printf("%02x ", (unsigned char)lbuf.data()[i]);
     std::printf("\n");
 
-    // Cleanup
-    UcxEndpoint::destroy_rkey(rkey);
-    return 0;
+    size_t bad = 0;
+    if (verify) bad = verify_region(fd, region, lbuf.data(), lbuf.size(), opts.verify_chunk);
+    ::close(fd);
+
+    // Cleanup: cached rkeys are released with the endpoint
+    return bad ? 1 : 0;
 }
@@ -0,0 +1,198 @@
+// Typed view over a server region: RemoteArray<T> treats the region (from the
+// handshake's RegionDesc) as an array of T and moves elements with batched
+// RMA ops.
+// - gather/scatter sort the requested indices and coalesce them into runs, so
+//   a random batch costs one GET/PUT per run instead of one per element.
+// - Gather runs also absorb gaps of up to kGapElems unused elements (fetched
+//   and discarded). The threshold follows from sizeof(T): reading a few
+//   hundred extra bytes is cheaper than posting another op. Scatter merges
+//   only adjacent indices, since writing a gap would clobber remote data.
+// - Elements are copied bytewise in the server's native layout; T must be
+//   trivially copyable and identical on both sides. Header-only.
+
+#pragma once
+
+#include "ucx_util.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+template <typename T>
+class RemoteArray {
+    static_assert(std::is_trivially_copyable<T>::value, "RemoteArray elements must be trivially copyable");
+
+public:
+    // Gather runs bridge gaps of up to kGapBytes (rounded down to whole
+    // elements), and no run grows past kMaxRunBytes.
+    static const size_t kGapBytes = 512;
+    static const size_t kMaxRunBytes = size_t(1) << 20;
+    static const size_t kGapElems = kGapBytes / sizeof(T);
+    static const size_t kMaxRunElems = kMaxRunBytes / sizeof(T) ? kMaxRunBytes / sizeof(T) : 1;
+
+    struct Stats {
+        uint64_t elements{0}; // elements requested
+        uint64_t ops{0};      // RMA ops posted (one per run)
+        uint64_t bytes{0};    // bytes moved, gap bytes included
+    };
+
+    // View of the region starting byte_offset bytes in; size() is the number
+    // of whole elements that fit after it.
+    RemoteArray(const UcxEnv& env, const UcxEndpoint& ep, ucp_rkey_h rkey, const RegionDesc& region,
+                uint64_t byte_offset = 0)
+        : env_(env), ep_(ep), rkey_(rkey), raddr_(region.remote_addr + byte_offset) {
+        if (byte_offset > region.size) throw std::runtime_error("RemoteArray: offset past region end");
+        size_ = static_cast<size_t>((region.size - byte_offset) / sizeof(T));
+    }
+
+    size_t size() const { return size_; }
+    const Stats& stats() const { return stats_; }
+
+    // out[i] = array[indices[i]]. Throws on an out-of-range index or a failed GET.
+    std::vector<T> gather(const std::vector<size_t>& indices) {
+        std::vector<T> out(indices.size());
+        if (indices.empty()) return out;
+        std::vector<std::pair<size_t, size_t>> order = sorted(indices); // (index, position)
+        std::vector<Run> runs = coalesce(order, kGapElems);
+
+        size_t total = 0;
+        for (const Run& r : runs) total += r.count;
+        reserve(total * sizeof(T));
+        std::vector<RmaOp> ops;
+        size_t off = 0;
+        for (Run& r : runs) {
+            r.staging = off;
+            ops.push_back(op(r));
+            off += r.count * sizeof(T);
+        }
+        if (ep_.get_batch(ops, staging_mem_.memh()) != UCS_OK) throw std::runtime_error("RemoteArray: gather failed");
+        account(indices.size(), runs);
+
+        // Every requested element lies inside exactly one run
+        size_t ri = 0;
+        for (const auto& e : order) {
+            while (e.first >= runs[ri].first + runs[ri].count) ++ri;
+            std::memcpy(&out[e.second], staging_.data() + runs[ri].staging + (e.first - runs[ri].first) * sizeof(T),
+                        sizeof(T));
+        }
+        return out;
+    }
+
+    // array[indices[i]] = values[i]; for a repeated index the last value wins.
+    // Remote completion is waited for. Throws on size mismatch, an
+    // out-of-range index or a failed PUT.
+    void scatter(const std::vector<size_t>& indices, const std::vector<T>& values) {
+        if (indices.size() != values.size()) throw std::runtime_error("RemoteArray: indices/values size mismatch");
+        if (indices.empty()) return;
+        std::vector<std::pair<size_t, size_t>> order = sorted(indices);
+        // Keep the last occurrence of each index (the sort is stable)
+        std::vector<std::pair<size_t, size_t>> uniq;
+        uniq.reserve(order.size());
+        for (const auto& e : order) {
+            if (!uniq.empty() && uniq.back().first == e.first) uniq.back() = e;
+            else uniq.push_back(e);
+        }
+        std::vector<Run> runs = coalesce(uniq, 0);
+
+        reserve(uniq.size() * sizeof(T));
+        for (size_t i = 0; i < uniq.size(); ++i)
+            std::memcpy(staging_.data() + i * sizeof(T), &values[uniq[i].second], sizeof(T));
+        std::vector<RmaOp> ops;
+        size_t off = 0;
+        for (Run& r : runs) {
+            r.staging = off;
+            ops.push_back(op(r));
+            off += r.count * sizeof(T);
+        }
+        if (ep_.put_batch(ops, staging_mem_.memh()) != UCS_OK) throw std::runtime_error("RemoteArray: scatter failed");
+        account(indices.size(), runs);
+    }
+
+    T get(size_t index) { return gather(std::vector<size_t>{index})[0]; }
+    void put(size_t index, const T& value) { scatter(std::vector<size_t>{index}, std::vector<T>{value}); }
+
+private:
+    // Elements [first, first+count) fetched to / sent from staging_+staging.
+    struct Run {
+        size_t first;
+        size_t count;
+        size_t staging;
+    };
+
+    std::vector<std::pair<size_t, size_t>> sorted(const std::vector<size_t>& indices) const {
+        std::vector<std::pair<size_t, size_t>> order(indices.size());
+        for (size_t i = 0; i < indices.size(); ++i) {
+            if (indices[i] >= size_) throw std::runtime_error("RemoteArray: index out of range");
+            order[i] = std::make_pair(indices[i], i);
+        }
+        std::stable_sort(order.begin(), order.end(),
+                         [](const std::pair<size_t, size_t>& a, const std::pair<size_t, size_t>& b) {
+                             return a.first < b.first;
+                         });
+        return order;
+    }
+
+    // Merges sorted indices whose distance is at most gap+1 into runs.
+    static std::vector<Run> coalesce(const std::vector<std::pair<size_t, size_t>>& order, size_t gap) {
+        std::vector<Run> runs;
+        for (const auto& e : order) {
+            if (!runs.empty()) {
+                Run& r = runs.back();
+                size_t end = r.first + r.count; // one past the run
+                if (e.first < end) continue;    // duplicate index
+                if (e.first - end <= gap && e.first - r.first < kMaxRunElems) {
+                    r.count = e.first - r.first + 1;
+                    continue;
+                }
+            }
+            runs.push_back(Run{e.first, 1, 0});
+        }
+        return runs;
+    }
+
+    RmaOp op(const Run& r) {
+        RmaOp o;
+        o.laddr = staging_.data() + r.staging;
+        o.raddr = raddr_ + static_cast<uint64_t>(r.first) * sizeof(T);
+        o.len = r.count * sizeof(T);
+        o.rkey = rkey_;
+        return o;
+    }
+
+    // Staging grows geometrically and is re-registered only when it grows.
+    void reserve(size_t bytes) {
+        if (bytes <= staging_.size()) return;
+        staging_mem_ = UcxMem(); // unregister before resize() frees the old buffer
+        staging_.resize(std::max(bytes, staging_.size() * 2));
+        staging_mem_ = UcxMem(env_.ctx(), staging_.data(), staging_.size());
+    }
+
+    void account(size_t elements, const std::vector<Run>& runs) {
+        stats_.elements += elements;
+        stats_.ops += runs.size();
+        for (const Run& r : runs) stats_.bytes += r.count * sizeof(T);
+    }
+
+    const UcxEnv& env_;
+    const UcxEndpoint& ep_;
+    ucp_rkey_h rkey_{nullptr};
+    uint64_t raddr_{0};
+    size_t size_{0};
+    std::vector<char> staging_;
+    UcxMem staging_mem_;
+    Stats stats_;
+};
+
+template <typename T>
+const size_t RemoteArray<T>::kGapBytes;
+template <typename T>
+const size_t RemoteArray<T>::kMaxRunBytes;
+template <typename T>
+const size_t RemoteArray<T>::kGapElems;
+template <typename T>
+const size_t RemoteArray<T>::kMaxRunElems;
@@ -0,0 +1,200 @@
+#include "rma_kv.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+uint64_t key_hash(const std::string& key) {
+    uint64_t h = 0xcbf29ce484222325ull; // FNV-1a
+    for (unsigned char c : key) {
+        h ^= c;
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+uint32_t bucket_crc(const RmaKvBucket& b) {
+    RmaKvBucket tmp = b;
+    tmp.crc = 0;
+    return crc32c(0, &tmp, sizeof(tmp));
+}
+
+} // namespace
+
+const uint32_t RmaKvClient::kProbeWindow;
+const int RmaKvClient::kMaxRetries;
+
+RmaKvTable::RmaKvTable(void* base, size_t len, uint32_t value_slot) : base_(static_cast<char*>(base)) {
+    if (len < sizeof(RmaKvHeader)) throw std::runtime_error("kv: region too small");
+    size_t per_bucket = sizeof(RmaKvBucket) + value_slot;
+    size_t fit = (len - sizeof(RmaKvHeader)) / per_bucket;
+    uint32_t n = 1;
+    while (static_cast<size_t>(n) * 2 <= fit && n < (1u << 30)) n *= 2;
+    if (n < 2) throw std::runtime_error("kv: region too small for two buckets");
+
+    std::memset(base_, 0, len);
+    hdr_ = reinterpret_cast<RmaKvHeader*>(base_);
+    hdr_->nbuckets = n;
+    hdr_->value_slot = value_slot;
+    hdr_->buckets_off = sizeof(RmaKvHeader);
+    hdr_->values_off = sizeof(RmaKvHeader) + static_cast<uint64_t>(n) * sizeof(RmaKvBucket);
+    hdr_->version = RmaKvHeader::kVersion;
+    std::atomic_thread_fence(std::memory_order_release);
+    hdr_->magic = RmaKvHeader::kMagic; // last: readers never see a half-formatted header
+}
+
+RmaKvBucket* RmaKvTable::bucket(uint32_t idx) const {
+    return reinterpret_cast<RmaKvBucket*>(base_ + hdr_->buckets_off) + idx;
+}
+
+char* RmaKvTable::value(uint32_t idx) const {
+    return base_ + hdr_->values_off + static_cast<uint64_t>(idx) * hdr_->value_slot;
+}
+
+// Publishes a new bucket state: odd version, payload, even version.
+void RmaKvTable::write(uint32_t idx, uint64_t hash, const std::string& key, const std::string* value) {
+    RmaKvBucket* b = bucket(idx);
+    uint64_t v = b->version;
+    __atomic_store_n(&b->version, v + 1, __ATOMIC_RELEASE);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    RmaKvBucket nb{};
+    nb.version = v + 2;
+    nb.key_hash = hash;
+    nb.key_len = static_cast<uint16_t>(key.size());
+    std::memcpy(nb.key, key.data(), key.size());
+    if (value) {
+        std::memcpy(this->value(idx), value->data(), value->size());
+        nb.state = RmaKvBucket::kLive;
+        nb.val_len = static_cast<uint32_t>(value->size());
+        nb.val_crc = crc32c(0, value->data(), value->size());
+    } else {
+        nb.state = RmaKvBucket::kTombstone;
+    }
+    nb.crc = bucket_crc(nb);
+
+    // Everything but the version word, then the version last.
+    std::memcpy(reinterpret_cast<char*>(b) + sizeof(uint64_t), reinterpret_cast<const char*>(&nb) + sizeof(uint64_t),
+                sizeof(nb) - sizeof(uint64_t));
+    std::atomic_thread_fence(std::memory_order_release);
+    __atomic_store_n(&b->version, v + 2, __ATOMIC_RELEASE);
+}
+
+bool RmaKvTable::put(const std::string& key, const std::string& value) {
+    if (key.empty() || key.size() > RmaKvBucket::kMaxKey || value.size() > hdr_->value_slot) return false;
+    uint64_t h = key_hash(key);
+    uint32_t mask = hdr_->nbuckets - 1;
+    uint32_t reuse = hdr_->nbuckets; // first tombstone on the probe path
+    for (uint32_t i = 0; i < hdr_->nbuckets; ++i) {
+        uint32_t idx = (static_cast<uint32_t>(h) + i) & mask;
+        const RmaKvBucket* b = bucket(idx);
+        if (b->version == 0) {
+            if (reuse == hdr_->nbuckets) {
+                if (used_ + 1 >= hdr_->nbuckets) return false;
+                reuse = idx;
+                ++used_;
+            }
+            break;
+        }
+        if (b->state == RmaKvBucket::kTombstone) {
+            if (reuse == hdr_->nbuckets) reuse = idx;
+            continue;
+        }
+        if (b->key_hash == h && b->key_len == key.size() && std::memcmp(b->key, key.data(), key.size()) == 0) {
+            write(idx, h, key, &value);
+            return true;
+        }
+    }
+    if (reuse == hdr_->nbuckets) return false;
+    write(reuse, h, key, &value);
+    ++live_;
+    return true;
+}
+
+bool RmaKvTable::erase(const std::string& key) {
+    uint64_t h = key_hash(key);
+    uint32_t mask = hdr_->nbuckets - 1;
+    for (uint32_t i = 0; i < hdr_->nbuckets; ++i) {
+        uint32_t idx = (static_cast<uint32_t>(h) + i) & mask;
+        const RmaKvBucket* b = bucket(idx);
+        if (b->version == 0) return false;
+        if (b->state == RmaKvBucket::kLive && b->key_hash == h && b->key_len == key.size() &&
+            std::memcmp(b->key, key.data(), key.size()) == 0) {
+            write(idx, h, key, nullptr);
+            --live_;
+            return true;
+        }
+    }
+    return false;
+}
+
+RmaKvClient::RmaKvClient(const UcxEnv& env, const UcxEndpoint& ep, ucp_rkey_h rkey, const RegionDesc& region)
+    : env_(env), ep_(ep), rkey_(rkey), raddr_(region.remote_addr), rsize_(region.size) {
+    if (rsize_ < sizeof(RmaKvHeader)) throw std::runtime_error("kv: region too small");
+    read(&hdr_, sizeof(hdr_), 0);
+    if (hdr_.magic != RmaKvHeader::kMagic) throw std::runtime_error("kv: region is not a kv table");
+    if (hdr_.version != RmaKvHeader::kVersion) throw std::runtime_error("kv: unsupported table version");
+    if (hdr_.nbuckets == 0 || (hdr_.nbuckets & (hdr_.nbuckets - 1)) != 0 ||
+        hdr_.values_off + static_cast<uint64_t>(hdr_.nbuckets) * hdr_.value_slot > rsize_)
+        throw std::runtime_error("kv: bad table header");
+
+    scratch_.resize(std::max<size_t>(kProbeWindow * sizeof(RmaKvBucket), hdr_.value_slot));
+    scratch_mem_ = UcxMem(env.ctx(), scratch_.data(), scratch_.size());
+}
+
+void RmaKvClient::read(void* local, size_t len, uint64_t roff) {
+    ucp_request_param_t param{};
+    if (scratch_mem_.valid()) {
+        param.op_attr_mask = UCP_OP_ATTR_FIELD_MEMH;
+        param.memh = scratch_mem_.memh();
+    }
+    void* req = ep_.get_nbx(local, len, raddr_ + roff, rkey_, &param);
+    if (UCS_PTR_IS_ERR(req) || env_.wait(req) != UCS_OK) throw std::runtime_error("kv: get failed");
+    ++stats_.reads;
+}
+
+// One probe sequence: a window of buckets per GET, then one GET for the value.
+RmaKvClient::Probe RmaKvClient::lookup(uint64_t hash, const std::string& key, std::string& value) {
+    const uint32_t mask = hdr_.nbuckets - 1;
+    uint32_t probed = 0;
+    while (probed < hdr_.nbuckets) {
+        uint32_t idx = (static_cast<uint32_t>(hash) + probed) & mask;
+        uint32_t n = std::min(kProbeWindow, std::min(hdr_.nbuckets - idx, hdr_.nbuckets - probed)); // no wrap within a GET
+        read(scratch_.data(), n * sizeof(RmaKvBucket), hdr_.buckets_off + static_cast<uint64_t>(idx) * sizeof(RmaKvBucket));
+        for (uint32_t i = 0; i < n; ++i) {
+            RmaKvBucket b;
+            std::memcpy(&b, scratch_.data() + i * sizeof(RmaKvBucket), sizeof(b));
+            if (b.version == 0) return Probe::Miss;
+            if ((b.version & 1) || bucket_crc(b) != b.crc) return Probe::Retry;
+            if (b.state != RmaKvBucket::kLive || b.key_hash != hash || b.key_len != key.size() ||
+                std::memcmp(b.key, key.data(), key.size()) != 0)
+                continue;
+            if (b.val_len > hdr_.value_slot) return Probe::Retry;
+            read(scratch_.data(), b.val_len, hdr_.values_off + static_cast<uint64_t>(idx + i) * hdr_.value_slot);
+            if (crc32c(0, scratch_.data(), b.val_len) != b.val_crc) return Probe::Retry; // slot rewritten meanwhile
+            value.assign(scratch_.data(), b.val_len);
+            return Probe::Hit;
+        }
+        probed += n;
+    }
+    return Probe::Miss;
+}
+
+bool RmaKvClient::get(const std::string& key, std::string& value) {
+    ++stats_.gets;
+    if (key.empty() || key.size() > RmaKvBucket::kMaxKey) return false;
+    uint64_t h = key_hash(key);
+    for (int attempt = 0; attempt < kMaxRetries; ++attempt) {
+        Probe r = lookup(h, key, value);
+        if (r == Probe::Hit) {
+            ++stats_.hits;
+            return true;
+        }
+        if (r == Probe::Miss) return false;
+        ++stats_.retries;
+    }
+    throw std::runtime_error("kv: bucket failed validation too many times");
+}
@@ -0,0 +1,122 @@
+// One-sided key-value table hosted in a registered server region.
+// - The server formats the region as an open-addressing hash table (linear
+//   probing, fixed 64-byte buckets, one fixed-size value slot per bucket) and
+//   is the only writer.
+// - Clients resolve lookups with RMA GETs only: hash the key, read a window of
+//   buckets, validate, then read the value. No server CPU is involved.
+// - Structures are stored in the server's native byte order; client and server
+//   must share it (as with the raw RMA buffers themselves).
+
+#pragma once
+
+#include "ucx_util.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Region layout: [RmaKvHeader][nbuckets x RmaKvBucket][nbuckets x value_slot]
+struct RmaKvHeader {
+    static const uint32_t kMagic = 0x31564b52u; // "RKV1"
+    static const uint32_t kVersion = 1;
+
+    uint32_t magic;
+    uint32_t version;
+    uint32_t nbuckets;   // power of two
+    uint32_t value_slot; // bytes reserved per value
+    uint64_t buckets_off;
+    uint64_t values_off;
+    uint8_t pad[32];
+};
+static_assert(sizeof(RmaKvHeader) == 64, "RmaKvHeader must be 64 bytes");
+
+// Writers bump `version` to odd, update value and fields, then bump it to the
+// next even value. `crc` covers the whole bucket (including version) with the
+// crc field zeroed, so a torn or in-progress read fails validation; `val_crc`
+// ties the value slot contents to this bucket version. version == 0 marks a
+// bucket that was never written and ends a probe sequence.
+struct RmaKvBucket {
+    static const uint16_t kEmpty = 0;
+    static const uint16_t kLive = 1;
+    static const uint16_t kTombstone = 2; // erased; probing continues past it
+    static const size_t kMaxKey = 32;
+
+    uint64_t version;
+    uint64_t key_hash;
+    uint16_t key_len;
+    uint16_t state;
+    uint32_t val_len;
+    uint32_t val_crc;
+    uint32_t crc;
+    char key[kMaxKey];
+};
+static_assert(sizeof(RmaKvBucket) == 64, "RmaKvBucket must be 64 bytes");
+
+// Server side: formats and updates the table in place. Not thread-safe; all
+// writes must come from one thread (concurrent remote readers are fine).
+class RmaKvTable {
+public:
+    // Zeroes [base, base+len) and sizes the table to the largest power-of-two
+    // bucket count that fits. Throws if not even two buckets fit.
+    RmaKvTable(void* base, size_t len, uint32_t value_slot);
+
+    // Inserts or updates; false if key/value exceed the limits or the table is
+    // full (one bucket is always left empty so probes terminate).
+    bool put(const std::string& key, const std::string& value);
+    bool erase(const std::string& key);
+
+    size_t size() const { return live_; }
+    uint32_t nbuckets() const { return hdr_->nbuckets; }
+    uint32_t value_slot() const { return hdr_->value_slot; }
+
+private:
+    RmaKvBucket* bucket(uint32_t idx) const;
+    char* value(uint32_t idx) const;
+    void write(uint32_t idx, uint64_t hash, const std::string& key, const std::string* value);
+
+    char* base_{nullptr};
+    RmaKvHeader* hdr_{nullptr};
+    size_t live_{0};
+    size_t used_{0}; // live + tombstones
+};
+
+// Client side: lookups through one endpoint. Reads go through a small
+// registered scratch buffer. Not thread-safe.
+class RmaKvClient {
+public:
+    struct Stats {
+        uint64_t gets{0};
+        uint64_t hits{0};
+        uint64_t reads{0};   // RMA GETs issued
+        uint64_t retries{0}; // validation failures (concurrent server writes)
+    };
+
+    // Reads and validates the table header; throws if the region is not a table.
+    RmaKvClient(const UcxEnv& env, const UcxEndpoint& ep, ucp_rkey_h rkey, const RegionDesc& region);
+
+    // Returns false if the key is absent. Throws if a bucket keeps failing
+    // validation (e.g. a corrupted table).
+    bool get(const std::string& key, std::string& value);
+
+    const Stats& stats() const { return stats_; }
+    uint32_t nbuckets() const { return hdr_.nbuckets; }
+
+private:
+    static const uint32_t kProbeWindow = 4; // buckets fetched per GET
+    static const int kMaxRetries = 64;
+
+    enum class Probe { Hit, Miss, Retry };
+    Probe lookup(uint64_t hash, const std::string& key, std::string& value);
+    void read(void* local, size_t len, uint64_t roff);
+
+    const UcxEnv& env_;
+    const UcxEndpoint& ep_;
+    ucp_rkey_h rkey_{nullptr};
+    uint64_t raddr_{0};
+    uint64_t rsize_{0};
+    RmaKvHeader hdr_{};
+    std::vector<char> scratch_;
+    UcxMem scratch_mem_;
+    Stats stats_;
+};
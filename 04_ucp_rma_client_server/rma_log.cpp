@@ -0,0 +1,228 @@
+#include "rma_log.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+// Reads and validates the log header through ep; shared by writer and reader.
+RmaLogHeader read_header(const UcxEnv& env, const UcxEndpoint& ep, ucp_rkey_h rkey, const RegionDesc& region) {
+    if (region.size <= RmaLogHeader::kDataOff) throw std::runtime_error("log: region too small");
+    RmaLogHeader hdr{};
+    void* req = ep.get_nbx(&hdr, sizeof(hdr), region.remote_addr, rkey, nullptr);
+    if (UCS_PTR_IS_ERR(req) || env.wait(req) != UCS_OK) throw std::runtime_error("log: header get failed");
+    if (hdr.magic != RmaLogHeader::kMagic) throw std::runtime_error("log: region is not a log");
+    if (hdr.version != RmaLogHeader::kVersion) throw std::runtime_error("log: unsupported version");
+    if (hdr.data_len > region.size - RmaLogHeader::kDataOff) throw std::runtime_error("log: bad header");
+    return hdr;
+}
+
+} // namespace
+
+uint32_t RmaLogRecord::checksum(uint32_t len, uint32_t flags, const void* payload) {
+    uint32_t crc = crc32c(kCrcSeed, &len, sizeof(len));
+    crc = crc32c(crc, &flags, sizeof(flags));
+    return crc32c(crc, payload, len);
+}
+
+RmaLogRegion::RmaLogRegion(void* base, size_t len) {
+    if (len < RmaLogHeader::kDataOff + sizeof(RmaLogRecord)) throw std::runtime_error("log: region too small");
+    char* p = static_cast<char*>(base);
+    std::memset(p, 0, len);
+    hdr_ = reinterpret_cast<RmaLogHeader*>(p);
+    tail_ = reinterpret_cast<const uint64_t*>(p + RmaLogHeader::kTailOff);
+    hdr_->data_len = (len - RmaLogHeader::kDataOff) & ~uint64_t(7);
+    hdr_->version = RmaLogHeader::kVersion;
+    std::atomic_thread_fence(std::memory_order_release);
+    hdr_->magic = RmaLogHeader::kMagic;
+}
+
+uint64_t RmaLogRegion::tail() const {
+    return __atomic_load_n(tail_, __ATOMIC_RELAXED);
+}
+
+RmaLogWriter::RmaLogWriter(const UcxEnv& env, const UcxEndpoint& ep, ucp_rkey_h rkey, const RegionDesc& region,
+                           size_t depth, uint32_t max_record)
+    : env_(env), ep_(ep), rkey_(rkey), raddr_(region.remote_addr), hdr_(read_header(env, ep, rkey, region)),
+      max_record_(max_record), engine_(env) {
+    // Each slot: the padded record, then its 8-byte-aligned commit word
+    slot_bytes_ = RmaLogRecord::footprint(max_record_) + sizeof(uint64_t);
+    slots_.resize(std::max<size_t>(1, depth));
+    staging_.resize(slots_.size() * slot_bytes_);
+    staging_mem_ = UcxMem(env.ctx(), staging_.data(), staging_.size());
+    for (size_t i = 0; i < slots_.size(); ++i) {
+        uint32_t committed = RmaLogRecord::kCommitted;
+        std::memcpy(slot_data(i) + slot_bytes_ - sizeof(uint64_t), &committed, sizeof(committed));
+    }
+}
+
+RmaLogWriter::~RmaLogWriter() {
+    try {
+        while (engine_.pending() > 0) reap();
+    } catch (const std::exception&) {
+        // Failed appends were lost either way; nothing else to release
+    }
+}
+
+void RmaLogWriter::reap() {
+    engine_.progress();
+    UcxCompletion c;
+    while (engine_.poll(c)) {
+        auto it = slot_of_.find(c.id);
+        if (it == slot_of_.end()) continue;
+        size_t i = it->second;
+        slot_of_.erase(it);
+        if (c.status != UCS_OK) throw std::runtime_error("log: append failed");
+        Slot& s = slots_[i];
+        if (s.phase == Slot::Reserving) {
+            on_reserved(i);
+        } else if (--s.pending == 0) {
+            if (!s.end) {
+                ++stats_.appends;
+                stats_.bytes += s.len;
+            }
+            s.phase = Slot::Free;
+        }
+    }
+}
+
+// The fetch-add returned the record's offset: PUT the record, fence, PUT the
+// commit word. A reservation past the end marks the log full; the one that
+// crosses the end writes an end record in its place when a header fits.
+void RmaLogWriter::on_reserved(size_t i) {
+    Slot& s = slots_[i];
+    uint64_t fp = RmaLogRecord::footprint(s.len);
+    uint64_t data_raddr = raddr_ + RmaLogHeader::kDataOff;
+    if (s.offset + fp > hdr_.data_len) {
+        if (!full_) ++stats_.full;
+        full_ = true;
+        if (s.offset + sizeof(RmaLogRecord) > hdr_.data_len) {
+            s.phase = Slot::Free;
+            return;
+        }
+        RmaLogRecord end{0, 0, RmaLogRecord::checksum(0, RmaLogRecord::kEnd, nullptr), RmaLogRecord::kEnd};
+        std::memcpy(slot_data(i), &end, sizeof(end));
+        s.end = true;
+        fp = sizeof(RmaLogRecord);
+    }
+
+    ucp_request_param_t base{};
+    base.op_attr_mask = UCP_OP_ATTR_FIELD_MEMH;
+    base.memh = staging_mem_.memh();
+    const ucp_request_param_t p = engine_.param(&base);
+    s.phase = Slot::Writing;
+    s.pending = 2;
+    const size_t cw = sizeof(uint32_t); // the commit word leads the record
+    slot_of_[engine_.submit(ep_.put_nbx(slot_data(i) + cw, fp - cw, data_raddr + s.offset + cw, rkey_, &p))] = i;
+    // The record must land before its commit marker
+    if (ep_.fence() != UCS_OK) throw std::runtime_error("log: fence failed");
+    slot_of_[engine_.submit(ep_.put_nbx(slot_data(i) + slot_bytes_ - sizeof(uint64_t), cw, data_raddr + s.offset,
+                                        rkey_, &p))] = i;
+}
+
+bool RmaLogWriter::append(const void* data, uint32_t len) {
+    if (len > max_record_) throw std::runtime_error("log: record larger than max_record");
+    size_t i = slots_.size();
+    while (!full_) {
+        for (i = 0; i < slots_.size() && slots_[i].phase != Slot::Free; ++i) {
+        }
+        if (i < slots_.size()) break;
+        reap();
+    }
+    if (full_) return false;
+
+    Slot& s = slots_[i];
+    RmaLogRecord rec{0, len, RmaLogRecord::checksum(len, 0, data), 0};
+    char* local = slot_data(i);
+    std::memcpy(local, &rec, sizeof(rec));
+    std::memcpy(local + sizeof(rec), data, len);
+    std::memset(local + sizeof(rec) + len, 0, RmaLogRecord::footprint(len) - sizeof(rec) - len);
+    s.len = len;
+    s.end = false;
+    s.phase = Slot::Reserving;
+    const ucp_request_param_t p = engine_.param();
+    slot_of_[engine_.submit(ep_.fetch_add_nbx<uint64_t>(RmaLogRecord::footprint(len), &s.offset,
+                                                        raddr_ + RmaLogHeader::kTailOff, rkey_, &p))] = i;
+    return true;
+}
+
+bool RmaLogWriter::flush() {
+    while (engine_.pending() > 0 || std::any_of(slots_.begin(), slots_.end(),
+                                                [](const Slot& s) { return s.phase != Slot::Free; }))
+        reap();
+    const ucp_request_param_t p = engine_.param();
+    if (engine_.wait_all({engine_.submit(ep_.flush_nbx(&p))}) != UCS_OK) throw std::runtime_error("log: flush failed");
+    return !full_;
+}
+
+RmaLogReader::RmaLogReader(const UcxEnv& env, const UcxEndpoint& ep, ucp_rkey_h rkey, const RegionDesc& region,
+                           size_t window)
+    : env_(env), ep_(ep), rkey_(rkey), raddr_(region.remote_addr), hdr_(read_header(env, ep, rkey, region)) {
+    window = std::max<size_t>(window, RmaLogRecord::footprint(0)) & ~size_t(7);
+    buf_.resize(window + sizeof(uint64_t));
+    buf_mem_ = UcxMem(env.ctx(), buf_.data(), buf_.size());
+}
+
+void RmaLogReader::get(void* local, size_t len, uint64_t roff) {
+    ucp_request_param_t param{};
+    param.op_attr_mask = UCP_OP_ATTR_FIELD_MEMH;
+    param.memh = buf_mem_.memh();
+    void* req = ep_.get_nbx(local, len, raddr_ + roff, rkey_, &param);
+    if (UCS_PTR_IS_ERR(req) || env_.wait(req) != UCS_OK) throw std::runtime_error("log: get failed");
+}
+
+// Re-reads the window at the cursor, first reading the tail word if the
+// cursor has caught up with the last value seen. False if nothing is reserved
+// past the cursor.
+bool RmaLogReader::refill() {
+    if (tail_cache_ <= cursor_) {
+        char* tb = buf_.data() + buf_.size() - sizeof(uint64_t);
+        get(tb, sizeof(uint64_t), RmaLogHeader::kTailOff);
+        std::memcpy(&tail_cache_, tb, sizeof(tail_cache_));
+        ++stats_.tail_reads;
+    }
+    uint64_t limit = std::min(tail_cache_, hdr_.data_len);
+    if (limit <= cursor_) return false;
+    uint64_t n = std::min<uint64_t>(limit - cursor_, buf_.size() - sizeof(uint64_t));
+    get(buf_.data(), static_cast<size_t>(n), RmaLogHeader::kDataOff + cursor_);
+    ++stats_.gets;
+    buf_off_ = cursor_;
+    buf_len_ = n;
+    return true;
+}
+
+RmaLogReader::Result RmaLogReader::next(std::string& rec) {
+    const uint64_t window = buf_.size() - sizeof(uint64_t);
+    bool fetched = false;
+    while (true) {
+        if (cursor_ + sizeof(RmaLogRecord) > hdr_.data_len) return Result::End;
+        const uint64_t end = buf_off_ + buf_len_;
+        if (cursor_ >= buf_off_ && cursor_ + sizeof(RmaLogRecord) <= end) {
+            const char* p = buf_.data() + (cursor_ - buf_off_);
+            RmaLogRecord h;
+            std::memcpy(&h, p, sizeof(h));
+            if (h.commit == RmaLogRecord::kCommitted) {
+                // len and flags are only trusted once the CRC over them and
+                // the payload matches; until then they may still read as zero.
+                uint64_t fp = RmaLogRecord::footprint(h.len);
+                if (fp > window && cursor_ + fp <= hdr_.data_len)
+                    throw std::runtime_error("log: record larger than the read window");
+                if (cursor_ + fp <= end) {
+                    if (RmaLogRecord::checksum(h.len, h.flags, p + sizeof(h)) == h.crc) {
+                        if (h.flags & RmaLogRecord::kEnd) return Result::End;
+                        rec.assign(p + sizeof(h), h.len);
+                        cursor_ += fp;
+                        ++stats_.records;
+                        stats_.bytes += h.len;
+                        return Result::Record;
+                    }
+                    ++stats_.retries; // marker seen before the rest of the record; read again
+                }
+            }
+        }
+        if (fetched || !refill()) return Result::Empty;
+        fetched = true;
+    }
+}
@@ -0,0 +1,179 @@
+// Append-only shared log hosted in a registered server region.
+// - Any number of client writers append concurrently. Each reserves space
+//   with a remote fetch-add on the tail word, PUTs its record into the
+//   reserved range, fences, then PUTs the record's commit marker.
+// - Readers stream records in log order with GETs and stop at the first
+//   record whose marker is not set yet. The server only formats the region;
+//   no server thread is on the data path.
+// - The log does not wrap. The writer whose reservation crosses the end
+//   leaves an end record if one fits, so readers can tell a full log from a
+//   slow writer.
+// - A writer that dies between reservation and commit stalls readers at its
+//   record. Structures are stored in the server's native byte order.
+
+#pragma once
+
+#include "ucx_util.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Region layout (offsets in bytes):
+//   0   RmaLogHeader
+//   64  u64 tail  (bytes reserved so far; advanced by remote fetch-add)
+//   128 records, each [RmaLogRecord][payload] padded to 8 bytes; zeroed
+//       space reads as an uncommitted record
+struct RmaLogHeader {
+    static const uint32_t kMagic = 0x31474c52u; // "RLG1"
+    static const uint32_t kVersion = 1;
+    static const uint64_t kTailOff = 64;
+    static const uint64_t kDataOff = 128;
+
+    uint32_t magic;
+    uint32_t version;
+    uint64_t data_len; // bytes available for records
+    uint8_t pad[48];
+};
+static_assert(sizeof(RmaLogHeader) == 64, "RmaLogHeader must be 64 bytes");
+
+// Record header. `commit` is written by its own PUT, fenced after the PUT of
+// the rest of the record (which starts right after it, so the two never
+// overlap). A reader that sees kCommitted sees the record; `crc` covers len,
+// flags and the payload and guards against a GET that observed the marker
+// before the rest of the record, header included.
+struct RmaLogRecord {
+    static const uint32_t kCommitted = 0x544d4f43u; // "COMT"
+    static const uint32_t kEnd = 1;                 // flag: log full, no records follow
+    static const uint32_t kCrcSeed = 0x31474c52u;   // non-zero, so a zeroed header never validates
+
+    uint32_t commit;
+    uint32_t len;
+    uint32_t crc;
+    uint32_t flags;
+
+    // Bytes a record with `len` payload bytes occupies in the log.
+    static uint64_t footprint(uint64_t len) { return (sizeof(RmaLogRecord) + len + 7) & ~uint64_t(7); }
+    // Value of `crc` for a record with this len, flags and payload.
+    static uint32_t checksum(uint32_t len, uint32_t flags, const void* payload);
+};
+static_assert(sizeof(RmaLogRecord) == 16, "RmaLogRecord must be 16 bytes");
+
+// Server side: zeroes [base, base+len) and writes the header. Throws if no
+// record fits. tail() reads the local tail word (for statistics only).
+class RmaLogRegion {
+public:
+    RmaLogRegion(void* base, size_t len);
+
+    uint64_t data_len() const { return hdr_->data_len; }
+    uint64_t tail() const;
+
+private:
+    RmaLogHeader* hdr_{nullptr};
+    const uint64_t* tail_{nullptr};
+};
+
+// Client writer. Keeps up to `depth` appends in flight, each in its own
+// registered staging slot: a fetch-add reserves the range, its completion
+// posts the record PUT, a fence and the commit PUT. Records land in the
+// order their reservations complete, which with depth > 1 may differ from
+// the order of append() calls. Not thread-safe; use one writer (and
+// endpoint) per thread or process.
+class RmaLogWriter {
+public:
+    struct Stats {
+        uint64_t appends{0}; // records committed (locally complete)
+        uint64_t bytes{0};   // payload bytes of those records
+        uint64_t full{0};    // appends rejected because the log was full
+    };
+
+    // Reads and validates the log header; throws if the region is not a log.
+    RmaLogWriter(const UcxEnv& env, const UcxEndpoint& ep, ucp_rkey_h rkey, const RegionDesc& region,
+                 size_t depth = 16, uint32_t max_record = 4096);
+    ~RmaLogWriter();
+    RmaLogWriter(const RmaLogWriter&) = delete;
+    RmaLogWriter& operator=(const RmaLogWriter&) = delete;
+
+    // Queues a record of len (<= max_record) bytes; waits only while `depth`
+    // appends are in flight. Returns false once the log is known to be full.
+    bool append(const void* data, uint32_t len);
+    // Waits until every queued append is committed in server memory. Returns
+    // false if any append found the log full.
+    bool flush();
+
+    const Stats& stats() const { return stats_; }
+
+private:
+    struct Slot {
+        enum Phase { Free, Reserving, Writing } phase{Free};
+        uint32_t len{0};
+        uint64_t offset{0}; // fetch-add result: log offset of the record
+        int pending{0};     // PUTs not yet complete in the Writing phase
+        bool end{false};    // writing the end record instead of this append
+    };
+
+    char* slot_data(size_t i) { return staging_.data() + i * slot_bytes_; }
+    void reap();
+    void on_reserved(size_t i);
+
+    const UcxEnv& env_;
+    const UcxEndpoint& ep_;
+    ucp_rkey_h rkey_{nullptr};
+    uint64_t raddr_{0};
+    RmaLogHeader hdr_{};
+    uint32_t max_record_{0};
+    size_t slot_bytes_{0};
+    std::vector<char> staging_; // depth slots: record + commit word
+    UcxMem staging_mem_;
+    std::vector<Slot> slots_;
+    UcxCompletionEngine engine_;
+    std::unordered_map<uint64_t, size_t> slot_of_; // op id -> slot
+    bool full_{false};
+    Stats stats_;
+};
+
+// Client reader: streams committed records in log order through a registered
+// read-ahead buffer of `window` bytes (at least one maximum record plus its
+// header). Not thread-safe.
+class RmaLogReader {
+public:
+    enum class Result { Record, Empty, End };
+
+    struct Stats {
+        uint64_t records{0};
+        uint64_t bytes{0};      // payload bytes delivered
+        uint64_t gets{0};       // record-window GETs
+        uint64_t tail_reads{0}; // tail-word GETs
+        uint64_t retries{0};    // committed records whose CRC did not match yet
+    };
+
+    RmaLogReader(const UcxEnv& env, const UcxEndpoint& ep, ucp_rkey_h rkey, const RegionDesc& region,
+                 size_t window = 1 << 20);
+
+    // Record: the next record is copied to `rec`. Empty: nothing committed
+    // past the cursor right now (poll again). End: the log is full and every
+    // record has been read.
+    Result next(std::string& rec);
+
+    uint64_t cursor() const { return cursor_; }
+    const Stats& stats() const { return stats_; }
+
+private:
+    void get(void* local, size_t len, uint64_t roff);
+    bool refill();
+
+    const UcxEnv& env_;
+    const UcxEndpoint& ep_;
+    ucp_rkey_h rkey_{nullptr};
+    uint64_t raddr_{0};
+    RmaLogHeader hdr_{};
+    std::vector<char> buf_;  // window bytes, then the 8-byte tail buffer
+    UcxMem buf_mem_;
+    uint64_t cursor_{0};     // data offset of the next record
+    uint64_t buf_off_{0};    // data offset of buf_[0]
+    uint64_t buf_len_{0};    // valid bytes in the window
+    uint64_t tail_cache_{0}; // last tail value read
+    Stats stats_;
+};
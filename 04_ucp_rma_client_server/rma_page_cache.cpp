@@ -0,0 +1,189 @@
+#include "rma_page_cache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+const size_t RemotePageCache::kWritebackBatch;
+
+RemotePageCache::RemotePageCache(const UcxEnv& env, const UcxEndpoint& ep, ucp_rkey_h rkey, const RegionDesc& region,
+                                 const PageCacheOptions& opts)
+    : ep_(ep), rkey_(rkey), raddr_(region.remote_addr), rsize_(region.size), bs_(opts.block_size) {
+    if (bs_ == 0) throw std::runtime_error("page cache: block size must be > 0");
+    size_t n = opts.capacity / bs_;
+    if (n < 2) throw std::runtime_error("page cache: capacity must hold at least two blocks");
+    nblocks_ = (rsize_ + bs_ - 1) / bs_;
+    readahead_ = std::min(opts.readahead, n / 2); // demand + readahead never claims every frame
+
+    // Frames live in one mapping registered once; every GET/PUT uses its memh
+    mem_ = RegionMemory::anonymous(n * bs_);
+    mem_.prefault(0);
+    mem_reg_ = UcxMem(env.ctx(), mem_.data(), mem_.size());
+    frames_.resize(n);
+    map_.reserve(n);
+}
+
+RemotePageCache::~RemotePageCache() {
+    try {
+        flush();
+    } catch (const std::exception&) {
+        // Dirty blocks are lost; callers that care call flush() themselves
+    }
+}
+
+size_t RemotePageCache::block_len(uint64_t block) const {
+    return static_cast<size_t>(std::min<uint64_t>(bs_, rsize_ - block * bs_));
+}
+
+// CLOCK: skips frames claimed by the current fill, gives referenced frames a
+// second chance and takes the first free or unreferenced one.
+uint32_t RemotePageCache::pick_victim() {
+    const uint32_t n = static_cast<uint32_t>(frames_.size());
+    while (true) {
+        uint32_t f = hand_;
+        hand_ = (hand_ + 1) % n;
+        Frame& fr = frames_[f];
+        if (fr.busy) continue;
+        if (fr.block != ~0ull && fr.ref) {
+            fr.ref = false;
+            continue;
+        }
+        return f;
+    }
+}
+
+// PUTs the given dirty frames back in batches (one flush per batch).
+void RemotePageCache::write_back(const std::vector<uint32_t>& frames) {
+    std::vector<RmaOp> ops;
+    for (size_t i = 0; i < frames.size(); i += kWritebackBatch) {
+        ops.clear();
+        size_t end = std::min(frames.size(), i + kWritebackBatch);
+        for (size_t j = i; j < end; ++j) {
+            const Frame& fr = frames_[frames[j]];
+            RmaOp op;
+            op.laddr = frame_data(frames[j]);
+            op.raddr = raddr_ + fr.block * bs_;
+            op.len = block_len(fr.block);
+            op.rkey = rkey_;
+            ops.push_back(op);
+            stats_.bytes_written += op.len;
+        }
+        if (ep_.put_batch(ops, mem_reg_.memh()) != UCS_OK) throw std::runtime_error("page cache: write-back failed");
+        for (size_t j = i; j < end; ++j) frames_[frames[j]].dirty = false;
+        stats_.writebacks += end - i;
+        ++stats_.writeback_batches;
+    }
+}
+
+// Loads `block` (its data only if need_data) plus, when the miss continues a
+// sequential stream, up to readahead_ following blocks, all in one GET batch.
+// Dirty victims are written back first, in one PUT batch.
+void RemotePageCache::fill(uint64_t block, bool need_data) {
+    std::vector<uint64_t> blocks{block};
+    if (block == next_seq_) {
+        for (uint64_t b = block + 1; b < nblocks_ && blocks.size() <= readahead_; ++b)
+            if (map_.find(b) == map_.end()) blocks.push_back(b);
+    }
+    next_seq_ = blocks.back() + 1;
+
+    std::vector<uint32_t> victims, dirty;
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        uint32_t f = pick_victim();
+        frames_[f].busy = true;
+        victims.push_back(f);
+        if (frames_[f].block != ~0ull && frames_[f].dirty) dirty.push_back(f);
+    }
+    try {
+        write_back(dirty);
+    } catch (...) {
+        for (uint32_t f : victims) frames_[f].busy = false;
+        throw;
+    }
+
+    std::vector<RmaOp> ops;
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        Frame& fr = frames_[victims[i]];
+        if (fr.block != ~0ull) {
+            map_.erase(fr.block);
+            ++stats_.evictions;
+        }
+        fr.block = blocks[i];
+        fr.dirty = false;
+        fr.ref = (i == 0);         // readahead blocks get no second chance until used
+        fr.prefetched = (i != 0);
+        map_[blocks[i]] = victims[i];
+        if (i == 0 && !need_data) continue;
+        RmaOp op;
+        op.laddr = frame_data(victims[i]);
+        op.raddr = raddr_ + blocks[i] * bs_;
+        op.len = block_len(blocks[i]);
+        op.rkey = rkey_;
+        ops.push_back(op);
+        stats_.bytes_fetched += op.len;
+    }
+    stats_.readahead += blocks.size() - 1;
+    ucs_status_t st = ops.empty() ? UCS_OK : ep_.get_batch(ops, mem_reg_.memh());
+    for (uint32_t f : victims) {
+        frames_[f].busy = false;
+        if (st != UCS_OK) { // contents unknown: drop the new mappings
+            map_.erase(frames_[f].block);
+            frames_[f] = Frame();
+        }
+    }
+    if (st != UCS_OK) throw std::runtime_error("page cache: fill failed");
+}
+
+uint32_t RemotePageCache::lookup(uint64_t block, bool will_overwrite, bool& hit) {
+    auto it = map_.find(block);
+    hit = (it != map_.end());
+    if (hit) {
+        Frame& fr = frames_[it->second];
+        fr.ref = true;
+        if (fr.prefetched) {
+            fr.prefetched = false;
+            ++stats_.readahead_hits;
+        }
+        ++stats_.hits;
+        return it->second;
+    }
+    ++stats_.misses;
+    fill(block, !will_overwrite);
+    return map_[block];
+}
+
+// Splits [off, off+len) at block boundaries and calls fn(frame_ptr, pos, n)
+// for each piece, where pos is the piece's offset into the caller's buffer.
+template <typename Fn>
+void RemotePageCache::for_each_piece(uint64_t off, size_t len, bool is_write, Fn fn) {
+    if (off > rsize_ || len > rsize_ - off) throw std::runtime_error("page cache: access out of range");
+    size_t pos = 0;
+    while (pos < len) {
+        uint64_t block = (off + pos) / bs_;
+        size_t in = static_cast<size_t>((off + pos) % bs_);
+        size_t n = std::min(len - pos, block_len(block) - in);
+        bool hit = false;
+        // A write covering the whole block needs no GET first
+        uint32_t f = lookup(block, is_write && in == 0 && n == block_len(block), hit);
+        fn(frame_data(f) + in, pos, n);
+        if (is_write) frames_[f].dirty = true;
+        if (hit) stats_.bytes_saved += n;
+        pos += n;
+    }
+}
+
+void RemotePageCache::read(uint64_t off, void* dst, size_t len) {
+    char* out = static_cast<char*>(dst);
+    for_each_piece(off, len, false, [out](const char* p, size_t pos, size_t n) { std::memcpy(out + pos, p, n); });
+}
+
+void RemotePageCache::write(uint64_t off, const void* src, size_t len) {
+    const char* in = static_cast<const char*>(src);
+    for_each_piece(off, len, true, [in](char* p, size_t pos, size_t n) { std::memcpy(p, in + pos, n); });
+}
+
+void RemotePageCache::flush() {
+    std::vector<uint32_t> dirty;
+    for (uint32_t f = 0; f < frames_.size(); ++f)
+        if (frames_[f].block != ~0ull && frames_[f].dirty) dirty.push_back(f);
+    write_back(dirty);
+}
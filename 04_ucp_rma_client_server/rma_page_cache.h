@@ -0,0 +1,97 @@
+// Client-side cache of remote region blocks (far-memory tier).
+// - A fixed number of local frames, each holding one block of the remote
+//   region, in one registered buffer. CLOCK (second-chance) eviction.
+// - Misses are filled with GETs; a miss that continues a sequential stream
+//   also fetches the next blocks (readahead) in the same batch.
+// - Writes are write-back: blocks are marked dirty and PUT back in batches
+//   when evicted or on flush().
+// - Single client: nothing keeps the cache coherent with other writers of the
+//   remote region.
+
+#pragma once
+
+#include "ucx_region.h"
+#include "ucx_util.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+struct PageCacheOptions {
+    size_t block_size{4096};       // bytes per block, e.g. 4K or 64K
+    size_t capacity{64u << 20};    // local bytes; rounded down to whole blocks
+    size_t readahead{8};           // blocks fetched past a sequential miss (0 = off)
+};
+
+// Not thread-safe.
+class RemotePageCache {
+public:
+    struct Stats {
+        uint64_t hits{0};             // block accesses served locally
+        uint64_t misses{0};           // block accesses that had to GET
+        uint64_t readahead{0};        // blocks fetched ahead of demand
+        uint64_t readahead_hits{0};   // readahead blocks later accessed
+        uint64_t evictions{0};
+        uint64_t writebacks{0};       // dirty blocks PUT back
+        uint64_t writeback_batches{0};
+        uint64_t bytes_fetched{0};    // GET bytes (demand + readahead)
+        uint64_t bytes_written{0};    // PUT bytes
+        uint64_t bytes_saved{0};      // access bytes served without a remote op
+    };
+
+    // The region must stay registered on the server for the cache's lifetime.
+    // Throws if block_size is 0 or fewer than two frames fit in capacity.
+    RemotePageCache(const UcxEnv& env, const UcxEndpoint& ep, ucp_rkey_h rkey, const RegionDesc& region,
+                    const PageCacheOptions& opts = PageCacheOptions());
+    // Writes back dirty blocks; errors are swallowed, call flush() to see them.
+    ~RemotePageCache();
+    RemotePageCache(const RemotePageCache&) = delete;
+    RemotePageCache& operator=(const RemotePageCache&) = delete;
+
+    // Copy [off, off+len) of the remote region out of / into the cache.
+    // Throw if the range is out of bounds or a remote op fails.
+    void read(uint64_t off, void* dst, size_t len);
+    void write(uint64_t off, const void* src, size_t len);
+    // PUTs every dirty block back and waits for remote completion.
+    void flush();
+
+    const Stats& stats() const { return stats_; }
+    size_t nframes() const { return frames_.size(); }
+    size_t block_size() const { return bs_; }
+
+private:
+    static const size_t kWritebackBatch = 64; // dirty blocks per put_batch
+
+    struct Frame {
+        uint64_t block{~0ull}; // cached block number, ~0 if free
+        bool ref{false};       // CLOCK reference bit
+        bool dirty{false};
+        bool prefetched{false}; // loaded by readahead and not accessed yet
+        bool busy{false};       // claimed by the fill in progress
+    };
+
+    char* frame_data(uint32_t f) const { return mem_.data() + static_cast<size_t>(f) * bs_; }
+    size_t block_len(uint64_t block) const;
+    uint32_t lookup(uint64_t block, bool will_overwrite, bool& hit);
+    uint32_t pick_victim();
+    void fill(uint64_t block, bool need_data);
+    void write_back(const std::vector<uint32_t>& frames);
+    template <typename Fn>
+    void for_each_piece(uint64_t off, size_t len, bool is_write, Fn fn);
+
+    const UcxEndpoint& ep_;
+    ucp_rkey_h rkey_{nullptr};
+    uint64_t raddr_{0};
+    uint64_t rsize_{0};
+    uint64_t nblocks_{0};
+    size_t bs_{0};
+    size_t readahead_{0};
+    RegionMemory mem_;
+    UcxMem mem_reg_;
+    std::vector<Frame> frames_;
+    std::unordered_map<uint64_t, uint32_t> map_; // block -> frame
+    uint32_t hand_{0};
+    uint64_t next_seq_{~0ull}; // block that would continue the last miss stream
+    Stats stats_;
+};
@@ -0,0 +1,149 @@
+#include "rma_queue.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+
+const size_t RmaQueueProducer::kStaging;
+
+namespace {
+
+// Slot header; seq is the 1-based position of the message in the stream, so a
+// zeroed or stale slot never matches the position being consumed.
+struct SlotHeader {
+    uint64_t seq;
+    uint32_t len;
+    uint32_t reserved;
+};
+static_assert(sizeof(SlotHeader) == RmaQueueHeader::kSlotHeader, "slot header size");
+
+} // namespace
+
+RmaQueueConsumer::RmaQueueConsumer(void* base, size_t len, uint32_t slot_size) : base_(static_cast<char*>(base)) {
+    slot_size = (std::max<uint32_t>(slot_size, RmaQueueHeader::kSlotHeader + 8) + 7) & ~7u;
+    if (len < RmaQueueHeader::kSlotsOff) throw std::runtime_error("queue: region too small");
+    size_t fit = (len - RmaQueueHeader::kSlotsOff) / slot_size;
+    uint32_t n = 1;
+    while (static_cast<size_t>(n) * 2 <= fit && n < (1u << 30)) n *= 2;
+    if (n < 2) throw std::runtime_error("queue: region too small for two slots");
+
+    std::memset(base_, 0, len);
+    hdr_ = reinterpret_cast<RmaQueueHeader*>(base_);
+    tail_ = reinterpret_cast<uint64_t*>(base_ + RmaQueueHeader::kTailOff);
+    head_ = reinterpret_cast<uint64_t*>(base_ + RmaQueueHeader::kHeadOff);
+    hdr_->nslots = n;
+    hdr_->slot_size = slot_size;
+    hdr_->version = RmaQueueHeader::kVersion;
+    std::atomic_thread_fence(std::memory_order_release);
+    hdr_->magic = RmaQueueHeader::kMagic;
+}
+
+bool RmaQueueConsumer::poll(std::string& msg) {
+    if (__atomic_load_n(tail_, __ATOMIC_ACQUIRE) == head_cache_) return false;
+    const char* slot = base_ + RmaQueueHeader::kSlotsOff +
+                       static_cast<uint64_t>(head_cache_ & (hdr_->nslots - 1)) * hdr_->slot_size;
+    SlotHeader sh;
+    std::memcpy(&sh, slot, sizeof(sh));
+    if (sh.seq != head_cache_ + 1 || sh.len > max_payload()) return false; // payload not landed yet
+    msg.assign(slot + sizeof(sh), sh.len);
+    ++head_cache_;
+    __atomic_store_n(head_, head_cache_, __ATOMIC_RELEASE); // frees the slot for the producer
+    return true;
+}
+
+RmaQueueProducer::RmaQueueProducer(const UcxEnv& env, const UcxEndpoint& ep, ucp_rkey_h rkey,
+                                   const RegionDesc& region)
+    : env_(env), ep_(ep), rkey_(rkey), raddr_(region.remote_addr) {
+    if (region.size < RmaQueueHeader::kSlotsOff) throw std::runtime_error("queue: region too small");
+    void* req = ep_.get_nbx(&hdr_, sizeof(hdr_), raddr_, rkey_, nullptr);
+    if (UCS_PTR_IS_ERR(req) || env_.wait(req) != UCS_OK) throw std::runtime_error("queue: header get failed");
+    if (hdr_.magic != RmaQueueHeader::kMagic) throw std::runtime_error("queue: region is not a queue");
+    if (hdr_.version != RmaQueueHeader::kVersion) throw std::runtime_error("queue: unsupported version");
+    if (hdr_.nslots == 0 || (hdr_.nslots & (hdr_.nslots - 1)) != 0 ||
+        hdr_.slot_size <= RmaQueueHeader::kSlotHeader ||
+        RmaQueueHeader::kSlotsOff + static_cast<uint64_t>(hdr_.nslots) * hdr_.slot_size > region.size)
+        throw std::runtime_error("queue: bad header");
+
+    staged_.resize(std::min<size_t>(kStaging, hdr_.nslots));
+    staging_.resize(staged_.size() * hdr_.slot_size + sizeof(uint64_t));
+    staging_mem_ = UcxMem(env.ctx(), staging_.data(), staging_.size());
+
+    // Resume after messages an earlier producer left behind; the consumer may
+    // not have drained them yet, so the head is read separately.
+    tail_ = remote_word(RmaQueueHeader::kTailOff);
+    head_cache_ = remote_head();
+    if (head_cache_ > tail_) throw std::runtime_error("queue: head past tail");
+}
+
+RmaQueueProducer::~RmaQueueProducer() {
+    for (Staged& s : staged_)
+        for (void* req : s.reqs) env_.wait(req);
+}
+
+uint64_t RmaQueueProducer::remote_word(uint64_t off) {
+    char* buf = staging_.data() + staging_.size() - sizeof(uint64_t);
+    ucp_request_param_t param{};
+    param.op_attr_mask = UCP_OP_ATTR_FIELD_MEMH;
+    param.memh = staging_mem_.memh();
+    void* req = ep_.get_nbx(buf, sizeof(uint64_t), raddr_ + off, rkey_, &param);
+    if (UCS_PTR_IS_ERR(req) || env_.wait(req) != UCS_OK) throw std::runtime_error("queue: word get failed");
+    uint64_t word;
+    std::memcpy(&word, buf, sizeof(word));
+    return word;
+}
+
+uint64_t RmaQueueProducer::remote_head() {
+    ++stats_.head_reads;
+    return remote_word(RmaQueueHeader::kHeadOff);
+}
+
+void RmaQueueProducer::wait_staged(Staged& s) {
+    for (void*& req : s.reqs) {
+        if (req && env_.wait(req) != UCS_OK) throw std::runtime_error("queue: put failed");
+        req = nullptr;
+    }
+}
+
+void RmaQueueProducer::enqueue(const void* data, size_t len) {
+    if (len > max_payload()) throw std::runtime_error("queue: message larger than slot");
+    if (tail_ - head_cache_ >= hdr_.nslots) {
+        ++stats_.full_waits;
+        while ((head_cache_ = remote_head()) + hdr_.nslots <= tail_) {
+        }
+    }
+
+    // Reuse the staging slot of the enqueue kStaging positions back.
+    Staged& s = staged_[tail_ % staged_.size()];
+    wait_staged(s);
+    char* local = staging_.data() + (tail_ % staged_.size()) * hdr_.slot_size;
+    SlotHeader sh{tail_ + 1, static_cast<uint32_t>(len), 0};
+    std::memcpy(local, &sh, sizeof(sh));
+    std::memcpy(local + sizeof(sh), data, len);
+    s.tail = tail_ + 1;
+
+    ucp_request_param_t param{};
+    param.op_attr_mask = UCP_OP_ATTR_FIELD_MEMH;
+    param.memh = staging_mem_.memh();
+    uint64_t slot_raddr = raddr_ + RmaQueueHeader::kSlotsOff + (tail_ & (hdr_.nslots - 1)) * hdr_.slot_size;
+    s.reqs[0] = ep_.put_nbx(local, sizeof(sh) + len, slot_raddr, rkey_, &param);
+    if (UCS_PTR_IS_ERR(s.reqs[0])) {
+        s.reqs[0] = nullptr;
+        throw std::runtime_error("queue: slot put failed");
+    }
+    // Payload must land before the consumer can observe the new tail.
+    if (ep_.fence() != UCS_OK) throw std::runtime_error("queue: fence failed");
+    s.reqs[1] = ep_.put_nbx(&s.tail, sizeof(s.tail), raddr_ + RmaQueueHeader::kTailOff, rkey_, nullptr);
+    if (UCS_PTR_IS_ERR(s.reqs[1])) {
+        s.reqs[1] = nullptr;
+        throw std::runtime_error("queue: tail put failed");
+    }
+    ++tail_;
+    ++stats_.enqueued;
+}
+
+void RmaQueueProducer::flush() {
+    for (Staged& s : staged_) wait_staged(s);
+    void* req = ep_.flush_nbx(nullptr);
+    if (UCS_PTR_IS_ERR(req) || env_.wait(req) != UCS_OK) throw std::runtime_error("queue: flush failed");
+}
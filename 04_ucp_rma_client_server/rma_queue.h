@@ -0,0 +1,112 @@
+// Single-producer ring queue hosted in a registered server region.
+// - The producer (client) writes a message into the next slot with one PUT,
+//   fences, then PUTs the new tail word. It only reads the remote head when the
+//   ring looks full.
+// - The consumer (server) polls its local tail word and advances the head in
+//   plain memory: no UCX calls on the receive side.
+// - Structures are stored in the server's native byte order.
+
+#pragma once
+
+#include "ucx_util.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Region layout (offsets in bytes):
+//   0   RmaQueueHeader
+//   64  u64 tail  (written remotely by the producer)
+//   128 u64 head  (written locally by the consumer)
+//   192 nslots x slot_size slots, each [u64 seq][u32 len][u32 reserved][payload]
+struct RmaQueueHeader {
+    static const uint32_t kMagic = 0x31514d52u; // "RMQ1"
+    static const uint32_t kVersion = 1;
+    static const uint64_t kTailOff = 64;
+    static const uint64_t kHeadOff = 128;
+    static const uint64_t kSlotsOff = 192;
+    static const uint32_t kSlotHeader = 16;
+
+    uint32_t magic;
+    uint32_t version;
+    uint32_t nslots;    // power of two
+    uint32_t slot_size; // bytes per slot including the 16-byte slot header
+    uint8_t pad[48];
+};
+static_assert(sizeof(RmaQueueHeader) == 64, "RmaQueueHeader must be 64 bytes");
+
+// Server side. Formats the region and consumes messages from one thread.
+class RmaQueueConsumer {
+public:
+    // Zeroes [base, base+len) and fits the largest power-of-two slot count.
+    // slot_size is rounded up to a multiple of 8; throws if fewer than two
+    // slots fit.
+    RmaQueueConsumer(void* base, size_t len, uint32_t slot_size);
+
+    // Pops the next message if the producer has published one. Slot contents
+    // are checked against their sequence number, so a tail that races ahead
+    // of its payload is simply seen on a later poll.
+    bool poll(std::string& msg);
+
+    uint32_t nslots() const { return hdr_->nslots; }
+    uint32_t max_payload() const { return hdr_->slot_size - RmaQueueHeader::kSlotHeader; }
+
+private:
+    char* base_{nullptr};
+    RmaQueueHeader* hdr_{nullptr};
+    uint64_t* tail_{nullptr};
+    uint64_t* head_{nullptr};
+    uint64_t head_cache_{0};
+};
+
+// Client side. Not thread-safe: there is exactly one producer per queue.
+// Messages are staged in a small registered ring so up to kStaging enqueues
+// can be in flight before the oldest has to complete locally.
+class RmaQueueProducer {
+public:
+    struct Stats {
+        uint64_t enqueued{0};
+        uint64_t head_reads{0}; // remote head GETs (ring looked full)
+        uint64_t full_waits{0}; // enqueues that had to wait for the consumer
+    };
+
+    // Reads and validates the queue header; throws if the region is not a queue.
+    RmaQueueProducer(const UcxEnv& env, const UcxEndpoint& ep, ucp_rkey_h rkey, const RegionDesc& region);
+    ~RmaQueueProducer();
+    RmaQueueProducer(const RmaQueueProducer&) = delete;
+    RmaQueueProducer& operator=(const RmaQueueProducer&) = delete;
+
+    // Enqueues len bytes (<= max_payload()), waiting while the ring is full.
+    void enqueue(const void* data, size_t len);
+    // Waits until every enqueued message is written to the server's memory.
+    void flush();
+
+    uint32_t nslots() const { return hdr_.nslots; }
+    uint32_t max_payload() const { return hdr_.slot_size - RmaQueueHeader::kSlotHeader; }
+    const Stats& stats() const { return stats_; }
+
+private:
+    static const size_t kStaging = 64;
+
+    struct Staged {
+        uint64_t tail{0};           // tail value published by this enqueue
+        void* reqs[2]{nullptr, nullptr}; // slot PUT, tail PUT
+    };
+
+    uint64_t remote_word(uint64_t off); // GETs the u64 at region offset off
+    uint64_t remote_head();
+    void wait_staged(Staged& s);
+
+    const UcxEnv& env_;
+    const UcxEndpoint& ep_;
+    ucp_rkey_h rkey_{nullptr};
+    uint64_t raddr_{0};
+    RmaQueueHeader hdr_{};
+    uint64_t tail_{0};
+    uint64_t head_cache_{0};
+    std::vector<char> staging_; // kStaging slots, then an 8-byte head buffer
+    UcxMem staging_mem_;
+    std::vector<Staged> staged_;
+    Stats stats_;
+};
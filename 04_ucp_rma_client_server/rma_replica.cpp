@@ -0,0 +1,105 @@
+#include "rma_replica.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+RmaQuorumWriter::RmaQuorumWriter(const UcxEnv& env, const std::vector<ReplicaTarget>& replicas, size_t quorum,
+                                 size_t max_backlog)
+    : engine_(env), quorum_(quorum), max_backlog_(max_backlog) {
+    if (replicas.empty()) throw std::runtime_error("replica: no replicas");
+    if (quorum == 0 || quorum > replicas.size()) throw std::runtime_error("replica: quorum out of range");
+    if (max_backlog == 0) throw std::runtime_error("replica: max_backlog must be >= 1");
+    reps_.resize(replicas.size());
+    for (size_t r = 0; r < replicas.size(); ++r) reps_[r].target = replicas[r];
+}
+
+RmaQuorumWriter::~RmaQuorumWriter() {
+    try {
+        drain();
+    } catch (const std::exception&) {
+        // Replica errors were reported by write() or are lost with the writer
+    }
+}
+
+// Posts queued writes to every replica that is below its backlog limit. The
+// flush after each PUT completes once that PUT (and all earlier ones on the
+// endpoint) is remotely complete.
+void RmaQuorumWriter::post_ready() {
+    const uint64_t end = base_seq_ + writes_.size();
+    for (size_t r = 0; r < reps_.size(); ++r) {
+        Replica& rep = reps_[r];
+        while (rep.inflight < max_backlog_ && rep.next < end) {
+            const Write& w = at(rep.next);
+            ucp_request_param_t base{};
+            if (w.memh) {
+                base.op_attr_mask = UCP_OP_ATTR_FIELD_MEMH;
+                base.memh = w.memh;
+            }
+            const ucp_request_param_t p = engine_.param(&base);
+            void* req = rep.target.ep->put_nbx(w.laddr, w.len, rep.target.raddr + w.offset, rep.target.rkey, &p);
+            if (UCS_PTR_IS_ERR(req)) throw std::runtime_error("replica " + std::to_string(r) + ": put failed");
+            ops_[engine_.submit(req)] = Op{r, rep.next, false};
+
+            const ucp_request_param_t fp = engine_.param();
+            req = rep.target.ep->flush_nbx(&fp);
+            if (UCS_PTR_IS_ERR(req)) throw std::runtime_error("replica " + std::to_string(r) + ": flush failed");
+            ops_[engine_.submit(req)] = Op{r, rep.next, true};
+            ++rep.next;
+            ++rep.inflight;
+        }
+    }
+}
+
+void RmaQuorumWriter::reap() {
+    engine_.progress();
+    UcxCompletion c;
+    bool freed = false;
+    while (engine_.poll(c)) {
+        auto it = ops_.find(c.id);
+        if (it == ops_.end()) continue;
+        Op op = it->second;
+        ops_.erase(it);
+        if (c.status != UCS_OK)
+            throw std::runtime_error("replica " + std::to_string(op.replica) + (op.flush ? ": flush" : ": put") +
+                                     " completion error");
+        if (!op.flush) continue;
+
+        Replica& rep = reps_[op.replica];
+        Write& w = at(op.seq);
+        double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - w.t0).count();
+        ++rep.stats.writes;
+        rep.stats.lat_us.push_back(us);
+        if (++w.acks <= quorum_) ++rep.stats.in_quorum;
+        if (w.acks == quorum_) quorum_lat_us_.push_back(us);
+        --rep.inflight;
+        freed = true;
+    }
+    // Retire writes every replica has flushed; their buffers are no longer read
+    while (!writes_.empty() && writes_.front().acks == reps_.size()) {
+        writes_.pop_front();
+        ++base_seq_;
+    }
+    if (freed) post_ready();
+}
+
+double RmaQuorumWriter::write(const void* laddr, size_t len, uint64_t offset, ucp_mem_h memh) {
+    for (size_t r = 0; r < reps_.size(); ++r)
+        if (offset > reps_[r].target.size || len > reps_[r].target.size - offset)
+            throw std::runtime_error("replica " + std::to_string(r) + ": write out of range");
+
+    const uint64_t seq = base_seq_ + writes_.size();
+    writes_.push_back(Write{laddr, len, offset, memh, std::chrono::steady_clock::now(), 0});
+    post_ready();
+    // The write may also be retired inside reap() if every replica was fast
+    while (seq >= base_seq_ && at(seq).acks < quorum_) reap();
+    double us = quorum_lat_us_.back(); // earlier writes reached their quorum before
+
+    for (Replica& rep : reps_)
+        rep.stats.max_lag = std::max<uint64_t>(rep.stats.max_lag, seq + 1 - rep.stats.writes);
+    return us;
+}
+
+void RmaQuorumWriter::drain() {
+    while (!writes_.empty()) reap();
+}
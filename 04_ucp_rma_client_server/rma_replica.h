@@ -0,0 +1,97 @@
+// Quorum-replicated PUTs to the same region on several servers.
+// - write() posts a PUT and an endpoint flush to every replica at once and
+//   returns as soon as `quorum` of the flushes have completed, i.e. the data
+//   is remotely complete on a quorum of servers.
+// - The remaining replicas keep completing in the background while later
+//   writes are issued; each replica may lag by up to `max_backlog` writes
+//   before further writes to it are queued locally.
+// - Per-replica latency is measured from the write() call to that replica's
+//   flush completion, so a lagging replica's queueing shows up in its numbers
+//   but not in the quorum latency.
+// - No failover: a failed PUT or flush on any replica throws.
+
+#pragma once
+
+#include "ucx_util.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+// One replica: an endpoint on the writer's worker and the target region.
+struct ReplicaTarget {
+    const UcxEndpoint* ep{nullptr};
+    ucp_rkey_h rkey{nullptr};
+    uint64_t raddr{0}; // region base address on that server
+    uint64_t size{0};  // region bytes
+};
+
+// Not thread-safe; every endpoint must belong to env's worker.
+class RmaQuorumWriter {
+public:
+    struct ReplicaStats {
+        uint64_t writes{0};    // writes flushed on this replica
+        uint64_t in_quorum{0}; // writes where this replica was among the first `quorum` acks
+        uint64_t max_lag{0};   // most writes this replica trailed the newest write by
+        std::vector<double> lat_us; // per-write latency, in flush order
+    };
+
+    // Throws if replicas is empty, quorum is 0 or larger than the replica
+    // count, or max_backlog is 0.
+    RmaQuorumWriter(const UcxEnv& env, const std::vector<ReplicaTarget>& replicas, size_t quorum,
+                    size_t max_backlog = 16);
+    // Waits for the stragglers; errors are swallowed, call drain() to see them.
+    ~RmaQuorumWriter();
+    RmaQuorumWriter(const RmaQuorumWriter&) = delete;
+    RmaQuorumWriter& operator=(const RmaQuorumWriter&) = delete;
+
+    // Writes [laddr, laddr+len) to [offset, offset+len) of every replica and
+    // returns the quorum latency in microseconds. memh (optional) registers
+    // laddr. The local bytes must stay valid and unchanged until drain():
+    // lagging replicas may still be reading them.
+    double write(const void* laddr, size_t len, uint64_t offset, ucp_mem_h memh = nullptr);
+    // Waits until every replica has flushed every write.
+    void drain();
+
+    size_t replicas() const { return reps_.size(); }
+    size_t quorum() const { return quorum_; }
+    const ReplicaStats& stats(size_t replica) const { return reps_[replica].stats; }
+    const std::vector<double>& quorum_lat_us() const { return quorum_lat_us_; }
+
+private:
+    struct Write {
+        const void* laddr;
+        size_t len;
+        uint64_t offset;
+        ucp_mem_h memh;
+        std::chrono::steady_clock::time_point t0;
+        size_t acks;
+    };
+    struct Replica {
+        ReplicaTarget target;
+        uint64_t next{0};     // sequence of the next write to post
+        size_t inflight{0};   // writes posted and not flushed yet
+        ReplicaStats stats;
+    };
+    struct Op {
+        size_t replica;
+        uint64_t seq;
+        bool flush; // the flush that completes write `seq` (else its PUT)
+    };
+
+    Write& at(uint64_t seq) { return writes_[static_cast<size_t>(seq - base_seq_)]; }
+    void post_ready();
+    void reap();
+
+    UcxCompletionEngine engine_;
+    std::vector<Replica> reps_;
+    size_t quorum_{0};
+    size_t max_backlog_{0};
+    std::deque<Write> writes_; // writes not yet flushed on every replica
+    uint64_t base_seq_{0};     // sequence of writes_.front()
+    std::unordered_map<uint64_t, Op> ops_; // op id -> op
+    std::vector<double> quorum_lat_us_;
+};
@@ -0,0 +1,93 @@
+#include "rma_snapshot.h"
+
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+
+const int RmaSnapshotReader::kMaxRetries;
+
+RmaSnapshotWriter::RmaSnapshotWriter(void* base, size_t len) : base_(static_cast<char*>(base)) {
+    if (len <= RmaSnapHeader::kDataOff) throw std::runtime_error("snapshot: region too small");
+    std::memset(base_, 0, len);
+    hdr_ = reinterpret_cast<RmaSnapHeader*>(base_);
+    seq_ = reinterpret_cast<uint64_t*>(base_ + RmaSnapHeader::kSeqOff);
+    hdr_->data_len = len - RmaSnapHeader::kDataOff;
+    hdr_->version = RmaSnapHeader::kVersion;
+    std::atomic_thread_fence(std::memory_order_release);
+    hdr_->magic = RmaSnapHeader::kMagic;
+}
+
+void RmaSnapshotWriter::begin() {
+    __atomic_store_n(seq_, *seq_ + 1, __ATOMIC_RELAXED);
+    std::atomic_thread_fence(std::memory_order_release); // odd seq is visible before any data store
+}
+
+void RmaSnapshotWriter::end() {
+    __atomic_store_n(seq_, *seq_ + 1, __ATOMIC_RELEASE);
+}
+
+void RmaSnapshotWriter::write(size_t off, const void* src, size_t n) {
+    if (off > data_len() || n > data_len() - off) throw std::runtime_error("snapshot: write out of range");
+    begin();
+    std::memcpy(data() + off, src, n);
+    end();
+}
+
+RmaSnapshotReader::RmaSnapshotReader(const UcxEnv& env, const UcxEndpoint& ep, ucp_rkey_h rkey,
+                                     const RegionDesc& region)
+    : env_(env), ep_(ep), rkey_(rkey), raddr_(region.remote_addr) {
+    if (region.size <= RmaSnapHeader::kDataOff) throw std::runtime_error("snapshot: region too small");
+    void* req = ep_.get_nbx(&hdr_, sizeof(hdr_), raddr_, rkey_, nullptr);
+    if (UCS_PTR_IS_ERR(req) || env_.wait(req) != UCS_OK) throw std::runtime_error("snapshot: header get failed");
+    if (hdr_.magic != RmaSnapHeader::kMagic) throw std::runtime_error("snapshot: region is not a snapshot area");
+    if (hdr_.version != RmaSnapHeader::kVersion) throw std::runtime_error("snapshot: unsupported version");
+    if (hdr_.data_len > region.size - RmaSnapHeader::kDataOff) throw std::runtime_error("snapshot: bad header");
+    seqs_mem_ = UcxMem(env.ctx(), seqs_, sizeof(seqs_));
+}
+
+// One seq / data / seq round. The fences keep the three GETs in order at the
+// target, so all of them are posted before waiting on any.
+bool RmaSnapshotReader::attempt(size_t off, size_t len, void* dst, ucp_mem_h dst_memh, uint64_t& seq) {
+    ucp_request_param_t sp{};
+    sp.op_attr_mask = UCP_OP_ATTR_FIELD_MEMH;
+    sp.memh = seqs_mem_.memh();
+    ucp_request_param_t dp{};
+    if (dst_memh) {
+        dp.op_attr_mask = UCP_OP_ATTR_FIELD_MEMH;
+        dp.memh = dst_memh;
+    }
+    const uint64_t seq_addr = raddr_ + RmaSnapHeader::kSeqOff;
+
+    void* reqs[3] = {nullptr, nullptr, nullptr};
+    int posted = 0;
+    bool ok = true;
+    auto post = [&](void* req) {
+        if (UCS_PTR_IS_ERR(req)) ok = false;
+        else reqs[posted++] = req;
+    };
+    post(ep_.get_nbx(&seqs_[0], sizeof(uint64_t), seq_addr, rkey_, &sp));
+    if (ok && ep_.fence() != UCS_OK) ok = false;
+    if (ok) post(ep_.get_nbx(dst, len, raddr_ + RmaSnapHeader::kDataOff + off, rkey_, &dp));
+    if (ok && ep_.fence() != UCS_OK) ok = false;
+    if (ok) post(ep_.get_nbx(&seqs_[1], sizeof(uint64_t), seq_addr, rkey_, &sp));
+    for (int i = 0; i < posted; ++i)
+        if (env_.wait(reqs[i]) != UCS_OK) ok = false; // drain everything posted before failing
+    if (!ok) throw std::runtime_error("snapshot: get failed");
+
+    seq = seqs_[0];
+    return (seqs_[0] & 1) == 0 && seqs_[0] == seqs_[1];
+}
+
+uint64_t RmaSnapshotReader::read(size_t off, size_t len, void* dst, ucp_mem_h dst_memh) {
+    if (off > hdr_.data_len || len > hdr_.data_len - off) throw std::runtime_error("snapshot: read out of range");
+    for (int i = 0; i < kMaxRetries; ++i) {
+        uint64_t seq = 0;
+        if (attempt(off, len, dst, dst_memh, seq)) {
+            ++stats_.reads;
+            stats_.bytes += len;
+            return seq;
+        }
+        ++stats_.retries;
+    }
+    throw std::runtime_error("snapshot: updates kept overlapping the read");
+}
@@ -0,0 +1,91 @@
+// Seqlock-protected snapshot area hosted in a registered server region.
+// - The server is the only writer. It bumps a sequence word to odd before an
+//   update and to the next even value after it.
+// - Clients read the sequence, the data and the sequence again with fenced
+//   RMA GETs and retry unless both reads saw the same even value, so a
+//   snapshot never mixes bytes from before and after an update.
+// - Structures are stored in the server's native byte order.
+
+#pragma once
+
+#include "ucx_util.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// Region layout (offsets in bytes):
+//   0   RmaSnapHeader
+//   64  u64 seq  (odd while an update is in progress)
+//   128 data_len bytes of snapshot data
+struct RmaSnapHeader {
+    static const uint32_t kMagic = 0x314e5352u; // "RSN1"
+    static const uint32_t kVersion = 1;
+    static const uint64_t kSeqOff = 64;
+    static const uint64_t kDataOff = 128;
+
+    uint32_t magic;
+    uint32_t version;
+    uint64_t data_len;
+    uint8_t pad[48];
+};
+static_assert(sizeof(RmaSnapHeader) == 64, "RmaSnapHeader must be 64 bytes");
+
+// Server side: formats the region and brackets updates with the sequence
+// word. Not thread-safe; all updates must come from one thread.
+class RmaSnapshotWriter {
+public:
+    // Zeroes [base, base+len); everything past the header and sequence word is
+    // snapshot data. Throws if no data byte fits.
+    RmaSnapshotWriter(void* base, size_t len);
+
+    // begin() makes the sequence odd, end() publishes the update. Direct
+    // writes to data() are only allowed in between.
+    void begin();
+    void end();
+    // begin(), copy n bytes to data()+off, end(). Throws if out of range.
+    void write(size_t off, const void* src, size_t n);
+
+    char* data() const { return base_ + RmaSnapHeader::kDataOff; }
+    size_t data_len() const { return static_cast<size_t>(hdr_->data_len); }
+    uint64_t seq() const { return *seq_; }
+
+private:
+    char* base_{nullptr};
+    RmaSnapHeader* hdr_{nullptr};
+    uint64_t* seq_{nullptr};
+};
+
+// Client side: consistent reads through one endpoint. Not thread-safe.
+class RmaSnapshotReader {
+public:
+    struct Stats {
+        uint64_t reads{0};   // snapshots delivered
+        uint64_t retries{0}; // attempts discarded because an update overlapped
+        uint64_t bytes{0};   // snapshot bytes delivered
+    };
+
+    // Reads and validates the header; throws if the region is not a snapshot area.
+    RmaSnapshotReader(const UcxEnv& env, const UcxEndpoint& ep, ucp_rkey_h rkey, const RegionDesc& region);
+
+    // Copies a consistent image of data[off, off+len) into dst and returns the
+    // sequence it belongs to. dst_memh (optional) must cover dst. Throws if
+    // the range is out of bounds or updates keep overlapping the read.
+    uint64_t read(size_t off, size_t len, void* dst, ucp_mem_h dst_memh = nullptr);
+
+    const Stats& stats() const { return stats_; }
+    uint64_t data_len() const { return hdr_.data_len; }
+
+private:
+    static const int kMaxRetries = 1000;
+
+    bool attempt(size_t off, size_t len, void* dst, ucp_mem_h dst_memh, uint64_t& seq);
+
+    const UcxEnv& env_;
+    const UcxEndpoint& ep_;
+    ucp_rkey_h rkey_{nullptr};
+    uint64_t raddr_{0};
+    RmaSnapHeader hdr_{};
+    uint64_t seqs_[2]{}; // sequence before / after the data GET
+    UcxMem seqs_mem_;
+    Stats stats_;
+};
@@ -1,82 +1,723 @@
 // Standalone UCX RMA demo server (no nixl dependency)
 // - Creates UCP context/worker
-// - Registers a buffer, packs rkey
-// - Sends handshake (worker address, rkey, remote addr, size) over TCP
+// - Registers one or more buffers (regions), packs each rkey once
+// - Sends handshake (worker address + region table) over TCP
 // - Accepts multiple client handshake connections
-// - Progresses worker and periodically prints first bytes for verification
+// - Progresses worker (busy polling, or event-driven with --event) and
+//   periodically prints first bytes for verification
+// - With --threads, runs one SINGLE-mode worker per core on a shared context and
+//   hands each client the address of one of them
+// - With --kv, formats one region as a one-sided key-value table (rma_kv.h)
+//   that clients query with GETs only; the server is its only writer
+// - With --queue, formats one region as a single-producer ring queue
+//   (rma_queue.h) drained by a consumer thread that only polls local memory
+// - With --snapshot, formats one region as a seqlock-protected snapshot area
+//   (rma_snapshot.h) that a writer thread keeps updating while clients read
+// - With --log, formats one region as an append-only shared log (rma_log.h):
+//   client writers reserve space with remote fetch-add, no server thread
+// - With --file, serves whole files as extra regions straight from an mmap of
+//   the page cache (no copy into the heap)
+// - Clients may send a notice after each PUT (put_notify); a dispatcher on
+//   every worker reacts to it from the progress loop, without buffer polling
+// - Handshake connections stay open as control channels; a control thread
+//   answers per-chunk CRC32C digest requests from clients running --verify
 
 #include "ucx_util.h"
+#include "rma_kv.h"
+#include "rma_queue.h"
+#include "rma_snapshot.h"
+#include "rma_log.h"
+#include "ucx_region.h"
+#include "ucx_verify.h"
 
+#include <cerrno>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <cstdint>
+#include <functional>
+#include <stdexcept>
 #include <string>
 #include <vector>
 #include <thread>
 #include <chrono>
 #include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
 #include <unistd.h>
 
+using Clock = std::chrono::steady_clock;
+
+// A registered buffer published to clients under `id`.
+struct ServerRegion {
+    uint32_t id{0};
+    RegionMemory buf; // anonymous or file mapping
+    UcxMem mem;
+    std::vector<char> rkey;
+};
+
+struct ServerOptions {
+    bool event{false}; // epoll on worker efd + listen socket instead of busy polling
+    long spin_us{50};  // event mode: keep spinning this long after the last activity
+    int threads{-1};   // >= 0: per-core worker threads (0 = one per online CPU)
+    bool least_load{false}; // assign clients to the worker with the fewest live clients instead of round-robin
+    long kv_region{-1};     // >= 0: region formatted as a key-value table
+    uint32_t kv_slot{128};  // bytes per value slot
+    size_t kv_keys{1000};   // demo keys inserted at startup
+    long queue_region{-1};  // >= 0: region formatted as a ring queue
+    uint32_t queue_slot{256}; // bytes per queue slot
+    long snap_region{-1};   // >= 0: region formatted as a seqlock snapshot area
+    size_t snap_update{4096}; // bytes rewritten per snapshot update
+    uint64_t snap_rate{10000}; // snapshot updates per second (0 = back to back)
+    long log_region{-1};    // >= 0: region formatted as a shared log
+    std::vector<std::string> files; // file-backed regions, ids after the sized ones
+    FileMapOptions file_opts;
+    AllocOptions alloc;      // sized regions: hugepages, NUMA node, init threads
+};
+
+// One per-core worker thread and what the acceptor knows about it.
+struct WorkerSlot {
+    size_t index{0};
+    std::unique_ptr<UcxEnv> env;        // SINGLE-mode worker on the shared context
+    std::vector<char> hs_blob;          // handshake advertising this worker
+    std::atomic<uint64_t> events{0};    // progress events, written by the worker thread
+    uint64_t last_events{0};            // acceptor-side snapshot
+    double rate{0};                     // progress events/s over the last tick
+    std::atomic<uint64_t> clients{0};   // live clients; decremented by the control thread
+    std::thread thread;
+};
+
+// Loop callbacks: a ready handshake connection, and a once-per-second tick.
+using ClientFn = std::function<void(int cfd)>;
+using TickFn = std::function<void()>;
+
+// Busy loop: progress UCX and poll the listening socket on every iteration.
+static void run_poll_loop(const UcxEnv& env, int lfd, const ClientFn& on_client, const TickFn& on_tick) {
+    auto last_tick = Clock::now();
+    while (true) {
+        // Progress UCX
+        env.progress();
+
+        // Poll for incoming connection with short timeout
+        int cfd = tcp::accept_nonblock(lfd);
+        if (cfd >= 0) on_client(cfd);
+
+        auto now = Clock::now();
+        if (now - last_tick > std::chrono::seconds(1)) {
+            last_tick = now;
+            on_tick();
+        }
+    }
+}
+
+static void epoll_add(int epfd, int fd) {
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    if (::epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0) throw std::runtime_error("epoll_ctl()");
+}
+
+// Event loop: the worker event fd and the listening socket share one epoll set.
+// After the last UCX activity the loop keeps spinning for `spin_us` (low wakeup
+// latency under load), then arms the worker and sleeps until either fd fires or
+// the next tick is due. While spinning, sockets are checked at most every 1 ms.
+static void run_event_loop(const UcxEnv& env, int lfd, long spin_us, const ClientFn& on_client,
+                           const TickFn& on_tick) {
+    int epfd = ::epoll_create1(EPOLL_CLOEXEC);
+    if (epfd < 0) throw std::runtime_error("epoll_create1()");
+    epoll_add(epfd, lfd);
+    epoll_add(epfd, env.event_fd());
+
+    const auto spin = std::chrono::microseconds(spin_us);
+    auto last_tick = Clock::now();
+    auto last_activity = last_tick;
+    auto last_sock_check = last_tick;
+    epoll_event evs[4];
+    while (true) {
+        auto now = Clock::now();
+        if (env.progress() > 0) last_activity = now;
+        if (now - last_tick > std::chrono::seconds(1)) {
+            last_tick = now;
+            on_tick();
+        }
+
+        bool sleep = now - last_activity >= spin;
+        int timeout_ms = 0;
+        if (sleep) {
+            ucs_status_t st = env.arm();
+            if (st == UCS_ERR_BUSY) continue; // events arrived meanwhile
+            if (st != UCS_OK) throw std::runtime_error("ucp_worker_arm failed");
+            auto until_tick = std::chrono::duration_cast<std::chrono::milliseconds>(
+                last_tick + std::chrono::seconds(1) - now);
+            timeout_ms = static_cast<int>(std::max<long long>(1, until_tick.count() + 1));
+        } else if (now - last_sock_check < std::chrono::milliseconds(1)) {
+            continue;
+        }
+        last_sock_check = now;
+
+        int n = ::epoll_wait(epfd, evs, 4, timeout_ms);
+        if (n < 0 && errno != EINTR) throw std::runtime_error("epoll_wait()");
+        for (int i = 0; i < n; ++i) {
+            if (evs[i].data.fd != lfd) continue; // worker efd: progressed next iteration
+            int cfd;
+            while ((cfd = tcp::accept_nonblock(lfd)) >= 0) on_client(cfd);
+        }
+        if (sleep) last_activity = Clock::now(); // woke up: spin again for follow-up traffic
+    }
+}
+
+static void pin_to_cpu(std::thread& t, unsigned cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(t.native_handle(), sizeof(set), &set);
+}
+
+// Worker thread: progress one worker, busy or (event mode) sleeping on its efd
+// after `spin_us` without activity.
+static void run_worker(const UcxEnv& wenv, bool event, long spin_us, std::atomic<uint64_t>& events) {
+    const auto spin = std::chrono::microseconds(spin_us);
+    pollfd pfd{};
+    if (event) {
+        pfd.fd = wenv.event_fd();
+        pfd.events = POLLIN;
+    }
+    auto last_activity = Clock::now();
+    while (true) {
+        unsigned n = wenv.progress();
+        if (n > 0) {
+            events.fetch_add(n, std::memory_order_relaxed);
+            last_activity = Clock::now();
+            continue;
+        }
+        if (!event || Clock::now() - last_activity < spin) continue;
+        ucs_status_t st = wenv.arm();
+        if (st == UCS_ERR_BUSY) continue;
+        if (st != UCS_OK) throw std::runtime_error("ucp_worker_arm failed");
+        ::poll(&pfd, 1, 1000);
+        last_activity = Clock::now();
+    }
+}
+
+// Acceptor loop for threaded mode: no UCX progress here, just block on the
+// listening socket until a client arrives or the next tick is due.
+static void run_accept_loop(int lfd, const ClientFn& on_client, const TickFn& on_tick) {
+    pollfd pfd{};
+    pfd.fd = lfd;
+    pfd.events = POLLIN;
+    auto last_tick = Clock::now();
+    while (true) {
+        auto until_tick = std::chrono::duration_cast<std::chrono::milliseconds>(
+            last_tick + std::chrono::seconds(1) - Clock::now());
+        int n = ::poll(&pfd, 1, static_cast<int>(std::max<long long>(0, until_tick.count() + 1)));
+        if (n < 0 && errno != EINTR) throw std::runtime_error("poll()");
+        if (n > 0 && (pfd.revents & POLLIN)) {
+            int cfd;
+            while ((cfd = tcp::accept_nonblock(lfd)) >= 0) on_client(cfd);
+        }
+        auto now = Clock::now();
+        if (now - last_tick > std::chrono::seconds(1)) {
+            last_tick = now;
+            on_tick();
+        }
+    }
+}
+
+// Queue consumer thread: spins on the ring's local tail word. Counts are
+// read by the tick to report the message rate.
+static void run_queue_consumer(RmaQueueConsumer& q, std::atomic<uint64_t>& msgs, std::atomic<uint64_t>& bytes) {
+    std::string msg;
+    while (true) {
+        if (!q.poll(msg)) continue;
+        msgs.fetch_add(1, std::memory_order_relaxed);
+        bytes.fetch_add(msg.size(), std::memory_order_relaxed);
+    }
+}
+
+// Snapshot writer: rewrites `update` bytes per step at a rotating offset, each
+// step bracketed by the seqlock, at `rate` steps per second (0 = unpaced).
+static void run_snapshot_writer(RmaSnapshotWriter& w, size_t update, uint64_t rate, std::atomic<uint64_t>& updates) {
+    update = std::max<size_t>(1, std::min(update, w.data_len()));
+    const size_t nwin = w.data_len() / update;
+    auto next = Clock::now();
+    const auto period = std::chrono::nanoseconds(rate ? 1000000000ull / rate : 0);
+    for (uint64_t gen = 1;; ++gen) {
+        if (rate) {
+            next += period;
+            std::this_thread::sleep_until(next);
+        }
+        size_t off = static_cast<size_t>(gen % nwin) * update;
+        w.begin();
+        std::memset(w.data() + off, static_cast<int>(gen & 0xFF), update);
+        w.end();
+        updates.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// Last put notice seen, for the tick print. Written from whichever worker
+// thread progressed the notice.
+struct NotifyLog {
+    std::mutex mu;
+    PutNotice last;
+    unsigned char first{0}; // first byte of the written range on arrival
+    uint64_t last_notices{0}; // tick-side snapshot
+};
+
+// Handshake connections handed over to the control thread. `live`, if set,
+// is decremented when the connection closes (the worker's client count).
+struct ControlChannels {
+    struct Channel {
+        int fd;
+        std::atomic<uint64_t>* live;
+    };
+    std::mutex mu;
+    std::vector<Channel> incoming;
+
+    void add(int fd, std::atomic<uint64_t>* live = nullptr) {
+        std::lock_guard<std::mutex> lock(mu);
+        incoming.push_back(Channel{fd, live});
+    }
+};
+
+// Answers one digest request from the region's current contents.
+static void serve_digests(int fd, const DigestRequest& req, const std::vector<ServerRegion>& regions) {
+    DigestReply rep;
+    const ServerRegion* reg = req.region < regions.size() ? &regions[req.region] : nullptr;
+    bool ok = reg && req.chunk > 0 && req.offset <= reg->buf.size() && req.len <= reg->buf.size() - req.offset &&
+              req.len / req.chunk + (req.len % req.chunk != 0) <= DigestReply::kMaxDigests;
+    if (!ok) {
+        rep.status = DigestReply::kBadRequest;
+        rep.send_fd(fd);
+        return;
+    }
+    auto t0 = Clock::now();
+    rep.digests = chunk_digests(reg->buf.data() + req.offset, req.len, req.chunk);
+    double ms = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    rep.send_fd(fd);
+    std::printf("[server] Digests for region %u: %zu chunk(s) of %llu bytes in %.3f ms\n", reg->id,
+                rep.digests.size(), (unsigned long long)req.chunk, ms);
+}
+
+// Control thread: polls every open handshake connection for digest requests
+// and closes connections whose client hung up. Runs beside any loop mode.
+// Reads never block: request bytes are collected per connection and a request
+// is served once its whole frame has arrived, so a client that stalls
+// mid-frame holds up only itself.
+static void run_control_loop(ControlChannels& ch, const std::vector<ServerRegion>& regions) {
+    std::vector<pollfd> fds;
+    std::vector<std::atomic<uint64_t>*> live; // parallel to fds
+    std::vector<std::string> partial;        // parallel to fds: bytes of the frame being received
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(ch.mu);
+            for (const ControlChannels::Channel& c : ch.incoming) {
+                fds.push_back(pollfd{c.fd, POLLIN, 0});
+                live.push_back(c.live);
+                partial.emplace_back();
+            }
+            ch.incoming.clear();
+        }
+        // Short timeout: newly handed-over connections are picked up quickly
+        int n = ::poll(fds.data(), fds.size(), 20);
+        if (n < 0 && errno != EINTR) throw std::runtime_error("poll()");
+        if (n <= 0) continue;
+        for (size_t i = 0; i < fds.size();) {
+            bool drop = false;
+            if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                try {
+                    std::string& buf = partial[i];
+                    char tmp[DigestRequest::kWireLen];
+                    ssize_t n = ::recv(fds[i].fd, tmp, DigestRequest::kWireLen - buf.size(), MSG_DONTWAIT);
+                    if (n == 0) {
+                        drop = true;
+                    } else if (n < 0) {
+                        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                            throw std::runtime_error("recv()");
+                    } else {
+                        buf.append(tmp, static_cast<size_t>(n));
+                        if (buf.size() == DigestRequest::kWireLen) {
+                            DigestRequest req = DigestRequest::deserialize(buf.data());
+                            buf.clear();
+                            serve_digests(fds[i].fd, req, regions);
+                        }
+                    }
+                } catch (const std::exception& e) {
+                    std::printf("[server] Control connection dropped: %s\n", e.what());
+                    drop = true;
+                }
+            }
+            if (drop) {
+                ::close(fds[i].fd);
+                if (live[i]) live[i]->fetch_sub(1, std::memory_order_relaxed);
+                fds[i] = fds.back();
+                fds.pop_back();
+                live[i] = live.back();
+                live.pop_back();
+                partial[i].swap(partial.back());
+                partial.pop_back();
+            } else {
+                ++i;
+            }
+        }
+    }
+}
+
+// Picks the worker for a new client. least_load: fewest live clients, then
+// the lowest event rate (one-sided traffic often produces no events on the
+// target, so the rate only separates workers when it is non-zero); remaining
+// ties rotate so equal workers share new clients.
+static WorkerSlot& assign_worker(std::vector<std::unique_ptr<WorkerSlot>>& workers, bool least_load, size_t& rr) {
+    const size_t n = workers.size();
+    if (!least_load) return *workers[rr++ % n];
+    WorkerSlot* best = nullptr;
+    uint64_t best_clients = 0;
+    for (size_t k = 0; k < n; ++k) {
+        WorkerSlot* w = workers[(rr + k) % n].get();
+        uint64_t c = w->clients.load(std::memory_order_relaxed);
+        if (!best || c < best_clients || (c == best_clients && w->rate < best->rate)) {
+            best = w;
+            best_clients = c;
+        }
+    }
+    rr = best->index + 1;
+    return *best;
+}
+
 int main(int argc, char** argv) {
     if (argc < 3) {
-        std::fprintf(stderr, "Usage: %s <port> <size_bytes>\n", argv[0]);
+        std::fprintf(stderr,
+                     "Usage: %s <port> <size_bytes>[,<size_bytes>...] [options]\n"
+                     "  --event[=<spin_us>]  event-driven loop on the worker efd; spin this long\n"
+                     "                       after the last activity before sleeping (default 50)\n"
+                     "  --threads=<n>        n per-core worker threads on one context (0 = all CPUs)\n"
+                     "  --assign=<rr|least>  threaded mode client placement (default rr)\n"
+                     "  --kv=<region_id>     serve this region as a one-sided key-value table\n"
+                     "  --kv-slot=<bytes>    value slot size (default 128)\n"
+                     "  --kv-keys=<n>        demo keys key0..key<n-1> inserted at startup (default 1000)\n"
+                     "  --queue=<region_id>  serve this region as a single-producer ring queue\n"
+                     "  --queue-slot=<bytes> queue slot size including a 16-byte header (default 256)\n"
+                     "  --snapshot=<region_id> serve this region as a seqlock snapshot area under a writer thread\n"
+                     "  --snapshot-update=<bytes> bytes rewritten per update (default 4096)\n"
+                     "  --snapshot-rate=<n>  updates per second (default 10000, 0 = back to back)\n"
+                     "  --log=<region_id>    serve this region as an append-only shared log\n"
+                     "  --file=<path>        serve a file as an extra region (repeatable, read-only)\n"
+                     "  --file-writable      map files read-write so client PUTs update them\n"
+                     "  --file-populate      prefault file mappings (MAP_POPULATE) before serving\n"
+                     "  --file-hugepages     madvise(MADV_HUGEPAGE) on file mappings\n"
+                     "  --hugepages=<none|thp|explicit>  back sized regions with hugepages\n"
+                     "  --numa=<node>        bind sized regions to a NUMA node\n"
+                     "  --init-threads=<n>   threads filling sized regions (0 = auto by size)\n",
+                     argv[0]);
         return 1;
     }
     uint16_t port = static_cast<uint16_t>(std::strtoul(argv[1], nullptr, 10));
-    size_t size = static_cast<size_t>(std::strtoull(argv[2], nullptr, 10));
-
-    // Allocate data buffer
-    std::vector<char> buf(size);
-    for (size_t i = 0; i < size; ++i) buf[i] = static_cast<char>(i & 0xFF);
+    std::vector<size_t> sizes = cli::parse_size_list(argv[2]);
+    if (sizes.empty()) {
+        std::fprintf(stderr, "no region sizes given\n");
+        return 1;
+    }
+    ServerOptions opts;
+    for (int i = 3; i < argc; ++i) {
+        const char* v = nullptr;
+        if (cli::is_flag(argv[i], "--event")) opts.event = true;
+        else if ((v = cli::opt_value(argv[i], "--event"))) {
+            opts.event = true;
+            opts.spin_us = std::strtol(v, nullptr, 10);
+        } else if ((v = cli::opt_value(argv[i], "--threads"))) {
+            opts.threads = std::atoi(v);
+        } else if ((v = cli::opt_value(argv[i], "--assign"))) {
+            opts.least_load = (std::strcmp(v, "least") == 0);
+            if (!opts.least_load && std::strcmp(v, "rr") != 0) {
+                std::fprintf(stderr, "--assign must be rr or least\n");
+                return 1;
+            }
+        } else if ((v = cli::opt_value(argv[i], "--kv"))) {
+            opts.kv_region = std::strtol(v, nullptr, 10);
+        } else if ((v = cli::opt_value(argv[i], "--kv-slot"))) {
+            opts.kv_slot = static_cast<uint32_t>(cli::parse_size(v));
+        } else if ((v = cli::opt_value(argv[i], "--kv-keys"))) {
+            opts.kv_keys = static_cast<size_t>(std::strtoull(v, nullptr, 10));
+        } else if ((v = cli::opt_value(argv[i], "--queue"))) {
+            opts.queue_region = std::strtol(v, nullptr, 10);
+        } else if ((v = cli::opt_value(argv[i], "--queue-slot"))) {
+            opts.queue_slot = static_cast<uint32_t>(cli::parse_size(v));
+        } else if ((v = cli::opt_value(argv[i], "--snapshot"))) {
+            opts.snap_region = std::strtol(v, nullptr, 10);
+        } else if ((v = cli::opt_value(argv[i], "--snapshot-update"))) {
+            opts.snap_update = cli::parse_size(v);
+        } else if ((v = cli::opt_value(argv[i], "--snapshot-rate"))) {
+            opts.snap_rate = std::strtoull(v, nullptr, 10);
+        } else if ((v = cli::opt_value(argv[i], "--log"))) {
+            opts.log_region = std::strtol(v, nullptr, 10);
+        } else if ((v = cli::opt_value(argv[i], "--file"))) {
+            opts.files.push_back(v);
+        } else if (cli::is_flag(argv[i], "--file-writable")) {
+            opts.file_opts.writable = true;
+        } else if (cli::is_flag(argv[i], "--file-populate")) {
+            opts.file_opts.populate = true;
+        } else if (cli::is_flag(argv[i], "--file-hugepages")) {
+            opts.file_opts.hugepages = true;
+        } else if (parse_alloc_option(argv[i], opts.alloc)) {
+            // --hugepages / --numa / --init-threads
+        } else {
+            std::fprintf(stderr, "unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (opts.kv_region >= static_cast<long>(sizes.size())) {
+        std::fprintf(stderr, "--kv region %ld does not exist\n", opts.kv_region);
+        return 1;
+    }
+    if (opts.queue_region >= static_cast<long>(sizes.size()) ||
+        (opts.queue_region >= 0 && opts.queue_region == opts.kv_region)) {
+        std::fprintf(stderr, "--queue region %ld is invalid\n", opts.queue_region);
+        return 1;
+    }
+    if (opts.snap_region >= static_cast<long>(sizes.size()) ||
+        (opts.snap_region >= 0 && (opts.snap_region == opts.kv_region || opts.snap_region == opts.queue_region))) {
+        std::fprintf(stderr, "--snapshot region %ld is invalid\n", opts.snap_region);
+        return 1;
+    }
+    if (opts.log_region >= static_cast<long>(sizes.size()) ||
+        (opts.log_region >= 0 && (opts.log_region == opts.kv_region || opts.log_region == opts.queue_region ||
+                                  opts.log_region == opts.snap_region))) {
+        std::fprintf(stderr, "--log region %ld is invalid\n", opts.log_region);
+        return 1;
+    }
 
     // Init UCX env
-    UcxEnv env;
+    bool threaded = opts.threads >= 0;
+    UcxEnvOptions env_opts;
+    env_opts.wakeup = opts.event;
+    env_opts.mt_workers_shared = threaded;
+    UcxEnv env(env_opts);
 
     // Worker address
     std::vector<char> waddr_copy = env.worker_address_bytes();
 
-    // Register memory and pack rkey
-    UcxMem mem(env.ctx(), buf.data(), buf.size());
+    // Allocate, register and pack every region exactly once. File regions are
+    // registered on the mapping itself: GETs read the page cache directly.
+    std::vector<ServerRegion> regions(sizes.size() + opts.files.size());
+    for (size_t r = 0; r < regions.size(); ++r) {
+        ServerRegion& reg = regions[r];
+        reg.id = static_cast<uint32_t>(r);
+        if (r < sizes.size()) {
+            // Pattern fill doubles as the first touch; it runs on several
+            // threads so multi-GB regions fault in (and fill) in parallel.
+            reg.buf = RegionMemory::anonymous(sizes[r], opts.alloc);
+            reg.buf.parallel_init(opts.alloc.init_threads, [](char* p, size_t off, size_t n) {
+                for (size_t i = 0; i < n; ++i) p[i] = static_cast<char>((off + i) & 0xFF);
+            });
+        } else {
+            reg.buf = RegionMemory::file(opts.files[r - sizes.size()], opts.file_opts);
+        }
+        reg.mem = UcxMem(env.ctx(), reg.buf.data(), reg.buf.size(), reg.buf.read_only() ? UcxMem::kReadOnly : 0);
+        reg.rkey = reg.mem.pack_rkey(env.ctx());
+        if (reg.buf.file_backed())
+            std::printf("[server] Region %u at %p size=%zu file=%s (%s)\n", reg.id, reg.buf.data(), reg.buf.size(),
+                        reg.buf.path().c_str(), reg.buf.read_only() ? "read-only" : "read-write");
+        else
+            std::printf("[server] Region %u at %p size=%zu\n", reg.id, reg.buf.data(), reg.buf.size());
+    }
+
+    // Key-value table: formatted in place in an already registered region
+    std::unique_ptr<RmaKvTable> kv;
+    if (opts.kv_region >= 0) {
+        ServerRegion& reg = regions[static_cast<size_t>(opts.kv_region)];
+        kv.reset(new RmaKvTable(reg.buf.data(), reg.buf.size(), opts.kv_slot));
+        for (size_t k = 0; k < opts.kv_keys; ++k)
+            if (!kv->put("key" + std::to_string(k), "value-" + std::to_string(k))) break;
+        std::printf("[server] Region %u: kv table, %u buckets, %u-byte values, %zu keys\n", reg.id, kv->nbuckets(),
+                    kv->value_slot(), kv->size());
+    }
+
+    // Ring queue: consumed by its own thread, independent of the UCX loop
+    std::unique_ptr<RmaQueueConsumer> queue;
+    std::atomic<uint64_t> queue_msgs{0}, queue_bytes{0};
+    uint64_t last_queue_msgs = 0;
+    std::thread queue_thread;
+    if (opts.queue_region >= 0) {
+        ServerRegion& reg = regions[static_cast<size_t>(opts.queue_region)];
+        queue.reset(new RmaQueueConsumer(reg.buf.data(), reg.buf.size(), opts.queue_slot));
+        std::printf("[server] Region %u: ring queue, %u slots, %u-byte payloads\n", reg.id, queue->nslots(),
+                    queue->max_payload());
+        queue_thread = std::thread([&]() { run_queue_consumer(*queue, queue_msgs, queue_bytes); });
+    }
+
+    // Snapshot area: updated by its own thread while clients read it
+    std::unique_ptr<RmaSnapshotWriter> snap;
+    std::atomic<uint64_t> snap_updates{0};
+    uint64_t last_snap_updates = 0;
+    std::thread snap_thread;
+    if (opts.snap_region >= 0) {
+        ServerRegion& reg = regions[static_cast<size_t>(opts.snap_region)];
+        snap.reset(new RmaSnapshotWriter(reg.buf.data(), reg.buf.size()));
+        std::printf("[server] Region %u: snapshot area, %zu data bytes, %zu-byte updates at %llu/s\n", reg.id,
+                    snap->data_len(), std::min(opts.snap_update, snap->data_len()), (unsigned long long)opts.snap_rate);
+        snap_thread = std::thread([&]() { run_snapshot_writer(*snap, opts.snap_update, opts.snap_rate, snap_updates); });
+    }
+
+    // Shared log: formatted once; clients append and read it without the server
+    std::unique_ptr<RmaLogRegion> log;
+    uint64_t last_log_tail = 0;
+    if (opts.log_region >= 0) {
+        ServerRegion& reg = regions[static_cast<size_t>(opts.log_region)];
+        log.reset(new RmaLogRegion(reg.buf.data(), reg.buf.size()));
+        std::printf("[server] Region %u: shared log, %llu data bytes\n", reg.id, (unsigned long long)log->data_len());
+    }
 
-    std::vector<char> rkey_copy = mem.pack_rkey(env.ctx());
+    // Put notices: every writable region gets a handler; the dispatcher is
+    // attached to each worker below and runs inside its progress loop.
+    UcxNotifyDispatcher notify;
+    NotifyLog notify_log;
+    for (const ServerRegion& reg : regions) {
+        if (reg.buf.read_only()) continue;
+        const char* base = reg.buf.data();
+        notify.on(reg.id, reg.buf.size(), [base, &notify_log](const PutNotice& n) {
+            std::lock_guard<std::mutex> lock(notify_log.mu);
+            notify_log.last = n;
+            notify_log.first = n.len ? static_cast<unsigned char>(base[n.offset]) : 0;
+        });
+    }
+    notify.attach(env.worker());
 
-    uint64_t raddr = reinterpret_cast<uint64_t>(buf.data());
+    // Handshake contents are identical for every client: serialize once
+    Handshake hs;
+    hs.worker_addr = waddr_copy;
+    for (const ServerRegion& reg : regions) {
+        RegionDesc d;
+        d.id = reg.id;
+        d.remote_addr = reinterpret_cast<uint64_t>(reg.buf.data());
+        d.size = static_cast<uint64_t>(reg.buf.size());
+        d.rkey = reg.rkey;
+        hs.regions.push_back(std::move(d));
+    }
+    const std::vector<char> hs_blob = hs.serialize();
+
+    // Threaded mode: one SINGLE-mode worker per core on the same context, so
+    // regions stay registered once and every worker shares the same rkeys.
+    std::vector<std::unique_ptr<WorkerSlot>> workers;
+    if (threaded) {
+        unsigned ncpu = std::max(1u, std::thread::hardware_concurrency());
+        unsigned nthreads = opts.threads > 0 ? static_cast<unsigned>(opts.threads) : ncpu;
+        UcxEnvOptions wopts;
+        wopts.thread_mode = UCS_THREAD_MODE_SINGLE;
+        wopts.wakeup = opts.event;
+        for (unsigned t = 0; t < nthreads; ++t) {
+            std::unique_ptr<WorkerSlot> w(new WorkerSlot);
+            w->index = t;
+            w->env.reset(new UcxEnv(env, wopts));
+            notify.attach(w->env->worker());
+            Handshake whs = hs;
+            whs.worker_addr = w->env->worker_address_bytes();
+            w->hs_blob = whs.serialize();
+            workers.push_back(std::move(w));
+        }
+        // Workers were set up here; from now on each is touched only by its thread.
+        for (unsigned t = 0; t < nthreads; ++t) {
+            WorkerSlot* w = workers[t].get();
+            w->thread = std::thread([w, &opts]() { run_worker(*w->env, opts.event, opts.spin_us, w->events); });
+            pin_to_cpu(w->thread, t % ncpu);
+        }
+    }
 
     // Handshake over TCP
     int lfd = tcp::listen(port);
-    std::printf("[server] Listening on port %u\n", (unsigned)port);
+    if (threaded) {
+        std::printf("[server] Listening on port %u (%zu worker threads, %s assignment)\n", (unsigned)port,
+                    workers.size(), opts.least_load ? "least-load" : "round-robin");
+    } else {
+        std::printf("[server] Listening on port %u (%s loop)\n", (unsigned)port, opts.event ? "event" : "poll");
+    }
 
-    // Event loop: accept with poll, progress UCX, and periodically print buffer head
-    auto last_print = std::chrono::steady_clock::now();
-    while (true) {
-        // Progress UCX
-        env.progress();
+    // Handshake connections are kept open as control channels (digest requests)
+    ControlChannels control;
+    std::thread control_thread([&]() { run_control_loop(control, regions); });
 
-        // Poll for incoming connection with short timeout
-        int cfd = tcp::accept_nonblock(lfd);
-        if (cfd >= 0) {
-            Handshake hs;
-            hs.worker_addr = waddr_copy;
-            hs.rkey = rkey_copy;
-            hs.remote_addr = reinterpret_cast<uint64_t>(buf.data());
-            hs.size = static_cast<uint64_t>(size);
-            hs.send_fd(cfd);
-            ::close(cfd);
-            std::printf("[server] Handshake sent. RMA buffer at %p size=%zu\n", buf.data(), size);
-        }
-
-        // Periodic print of first 16 bytes for visibility
-        auto now = std::chrono::steady_clock::now();
-        if (now - last_print > std::chrono::seconds(1)) {
-            last_print = now;
-            std::printf("[server] head: ");
-            size_t n = std::min<size_t>(16, buf.size());
-            for (size_t i = 0; i < n; ++i) std::printf("%02x ", (unsigned char)buf[i]);
+    auto on_client = [&](int cfd) {
+        Handshake::send_blob(cfd, hs_blob);
+        control.add(cfd);
+        std::printf("[server] Handshake sent. %zu region(s)\n", regions.size());
+    };
+    // Periodic print of first 16 bytes of each region for visibility; the kv
+    // table also gets its "tick" key rewritten so readers race a live writer
+    uint64_t ticks = 0;
+    auto on_tick = [&]() {
+        if (kv) kv->put("tick", std::to_string(++ticks));
+        if (snap) {
+            uint64_t u = snap_updates.load(std::memory_order_relaxed);
+            std::printf("[server] snapshot: %llu updates/s, %llu total\n", (unsigned long long)(u - last_snap_updates),
+                        (unsigned long long)u);
+            last_snap_updates = u;
+        }
+        if (log) {
+            uint64_t t = log->tail();
+            if (t != last_log_tail)
+                std::printf("[server] log: %.2f MB/s reserved, tail %llu of %llu bytes%s\n",
+                            (t - last_log_tail) / 1e6, (unsigned long long)t, (unsigned long long)log->data_len(),
+                            t >= log->data_len() ? " (full)" : "");
+            last_log_tail = t;
+        }
+        UcxNotifyDispatcher::Stats ns = notify.stats();
+        if (ns.notices != notify_log.last_notices) {
+            std::lock_guard<std::mutex> lock(notify_log.mu);
+            std::printf("[server] notify: %llu write(s)/s, %llu total (%llu bytes, %llu rejected); last region %u "
+                        "[%llu, +%llu) first byte %02x\n",
+                        (unsigned long long)(ns.notices - notify_log.last_notices), (unsigned long long)ns.notices,
+                        (unsigned long long)ns.bytes, (unsigned long long)ns.rejected, notify_log.last.region,
+                        (unsigned long long)notify_log.last.offset, (unsigned long long)notify_log.last.len,
+                        notify_log.first);
+            notify_log.last_notices = ns.notices;
+        }
+        if (queue) {
+            uint64_t m = queue_msgs.load(std::memory_order_relaxed);
+            std::printf("[server] queue: %llu msgs/s, %llu total (%llu bytes)\n",
+                        (unsigned long long)(m - last_queue_msgs), (unsigned long long)m,
+                        (unsigned long long)queue_bytes.load(std::memory_order_relaxed));
+            last_queue_msgs = m;
+        }
+        for (const ServerRegion& reg : regions) {
+            std::printf("[server] head[%u]: ", reg.id);
+            size_t n = std::min<size_t>(16, reg.buf.size());
+            for (size_t i = 0; i < n; ++i) std::printf("%02x ", (unsigned char)reg.buf.data()[i]);
             std::printf("\n");
         }
+    };
+
+    if (threaded) {
+        size_t rr = 0;
+        auto on_threaded_client = [&](int cfd) {
+            WorkerSlot& w = assign_worker(workers, opts.least_load, rr);
+            w.clients.fetch_add(1, std::memory_order_relaxed);
+            Handshake::send_blob(cfd, w.hs_blob);
+            control.add(cfd, &w.clients);
+            std::printf("[server] Handshake sent. Client -> worker %zu\n", w.index);
+        };
+        auto on_threaded_tick = [&]() {
+            // Refresh load estimates from the events each worker processed since the last tick
+            std::printf("[server] worker events/s (clients):");
+            for (auto& w : workers) {
+                uint64_t ev = w->events.load(std::memory_order_relaxed);
+                w->rate = static_cast<double>(ev - w->last_events);
+                w->last_events = ev;
+                std::printf(" %.0f (%llu)", w->rate, (unsigned long long)w->clients.load(std::memory_order_relaxed));
+            }
+            std::printf("\n");
+            on_tick();
+        };
+        run_accept_loop(lfd, on_threaded_client, on_threaded_tick);
+    } else if (opts.event) {
+        run_event_loop(env, lfd, opts.spin_us, on_client, on_tick);
+    } else {
+        run_poll_loop(env, lfd, on_client, on_tick);
     }
 
-    // Cleanup (unreachable in this loop)
+    // Cleanup (unreachable in these loops)
     return 0;
 }
@@ -0,0 +1,223 @@
+#include "ucx_buffer_pool.h"
+
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+static bool is_pow2(size_t v) { return v && !(v & (v - 1)); }
+
+UcxBufferPool::UcxBufferPool(ucp_context_h ctx, const Config& cfg)
+    : ctx_(ctx), cfg_(cfg), link_(std::make_shared<Link>()) {
+    if (!is_pow2(cfg_.min_class) || !is_pow2(cfg_.max_class) || cfg_.min_class > cfg_.max_class ||
+        cfg_.min_class < sizeof(FreeNode))
+        throw std::invalid_argument("UcxBufferPool: size classes must be powers of two >= 16");
+    if (cfg_.arena_bytes < cfg_.max_class) throw std::invalid_argument("UcxBufferPool: arena smaller than max_class");
+    if (cfg_.batch == 0) cfg_.batch = 1;
+    while ((cfg_.min_class << nclasses_) <= cfg_.max_class) ++nclasses_;
+    depot_.resize(nclasses_);
+    link_->pool = this;
+
+    std::lock_guard<std::mutex> lock(mu_);
+    map_arena_locked();
+}
+
+UcxBufferPool::~UcxBufferPool() {
+    {
+        // Waits for a thread that is retiring its cache right now
+        std::lock_guard<std::mutex> lock(link_->mu);
+        link_->pool = nullptr;
+    }
+    // UcxMem members unregister before the arena memory goes away.
+    for (auto& a : arenas_) {
+        char* base = a->base;
+        size_t len = a->len;
+        a.reset();
+        ::munmap(base, len);
+    }
+}
+
+uint32_t UcxBufferPool::class_of(size_t len) const {
+    if (len <= cfg_.min_class) return 0;
+    if (len > cfg_.max_class) throw std::length_error("UcxBufferPool: request exceeds max_class");
+    uint32_t bits = 64 - static_cast<uint32_t>(__builtin_clzll(static_cast<unsigned long long>(len - 1)));
+    uint32_t min_bits = static_cast<uint32_t>(__builtin_ctzll(static_cast<unsigned long long>(cfg_.min_class)));
+    return bits - min_bits;
+}
+
+// One per thread: the thread's cache in every pool it used. On thread exit the
+// caches of pools still alive go back to their depots.
+struct UcxBufferPool::ThreadCaches {
+    std::vector<std::pair<std::shared_ptr<Link>, ThreadCache*>> entries;
+
+    ~ThreadCaches() {
+        for (auto& e : entries) {
+            std::lock_guard<std::mutex> lock(e.first->mu);
+            if (e.first->pool) e.first->pool->retire_cache(e.second);
+        }
+    }
+};
+
+UcxBufferPool::ThreadCache& UcxBufferPool::local_cache() {
+    thread_local ThreadCaches tls;
+    for (const auto& e : tls.entries)
+        if (e.first == link_) return *e.second;
+
+    // First use of this pool on this thread: forget pools destroyed since
+    tls.entries.erase(std::remove_if(tls.entries.begin(), tls.entries.end(),
+                                     [](const std::pair<std::shared_ptr<Link>, ThreadCache*>& e) {
+                                         std::lock_guard<std::mutex> lock(e.first->mu);
+                                         return e.first->pool == nullptr;
+                                     }),
+                      tls.entries.end());
+    std::unique_ptr<ThreadCache> tc(new ThreadCache);
+    tc->lists.resize(nclasses_);
+    ThreadCache* raw = tc.get();
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        caches_.push_back(std::move(tc));
+    }
+    tls.entries.emplace_back(link_, raw);
+    return *raw;
+}
+
+// Called with link_->mu held by an exiting thread: spills its buffers and
+// drops its cache.
+void UcxBufferPool::retire_cache(ThreadCache* tc) {
+    for (uint32_t cls = 0; cls < nclasses_; ++cls)
+        if (tc->lists[cls].count) spill(tc->lists[cls], cls, 0);
+    std::lock_guard<std::mutex> lock(mu_);
+    for (size_t i = 0; i < caches_.size(); ++i) {
+        if (caches_[i].get() != tc) continue;
+        caches_[i] = std::move(caches_.back());
+        caches_.pop_back();
+        break;
+    }
+}
+
+UcxBuffer UcxBufferPool::alloc(size_t len) {
+    uint32_t cls = class_of(len);
+    FreeList& list = local_cache().lists[cls];
+    if (list.head == nullptr) refill(list, cls);
+
+    FreeNode* node = list.head;
+    list.head = node->next;
+    --list.count;
+
+    UcxBuffer buf;
+    buf.ptr = node;
+    buf.capacity = class_bytes(cls);
+    buf.memh = node->memh;
+    buf.size_class = cls;
+    return buf;
+}
+
+void UcxBufferPool::free(const UcxBuffer& buf) {
+    if (!buf) return;
+    FreeList& list = local_cache().lists[buf.size_class];
+    FreeNode* node = static_cast<FreeNode*>(buf.ptr);
+    node->next = list.head;
+    node->memh = buf.memh;
+    list.head = node;
+    if (++list.count >= 2 * cfg_.batch) spill(list, buf.size_class, cfg_.batch);
+}
+
+void UcxBufferPool::flush_thread_cache() {
+    ThreadCache& tc = local_cache();
+    for (uint32_t cls = 0; cls < nclasses_; ++cls)
+        if (tc.lists[cls].count) spill(tc.lists[cls], cls, 0);
+}
+
+UcxBufferPool::Stats UcxBufferPool::stats() const {
+    std::lock_guard<std::mutex> lock(mu_);
+    Stats st;
+    st.arenas = arenas_.size();
+    for (const auto& a : arenas_) st.mapped_bytes += a->len;
+    st.refills = refills_.load(std::memory_order_relaxed);
+    st.spills = spills_.load(std::memory_order_relaxed);
+    return st;
+}
+
+void UcxBufferPool::refill(FreeList& list, uint32_t cls) {
+    refills_.fetch_add(1, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(mu_);
+    FreeList& depot = depot_[cls];
+    if (depot.head == nullptr) carve_locked(depot, cls);
+
+    // Move up to one batch from the depot to the thread list.
+    for (size_t i = 0; i < cfg_.batch && depot.head; ++i) {
+        FreeNode* node = depot.head;
+        depot.head = node->next;
+        --depot.count;
+        node->next = list.head;
+        list.head = node;
+        ++list.count;
+    }
+}
+
+void UcxBufferPool::spill(FreeList& list, uint32_t cls, size_t keep) {
+    spills_.fetch_add(1, std::memory_order_relaxed);
+    // Detach everything past the first `keep` nodes without holding the lock.
+    FreeNode* first = list.head;
+    FreeNode* last = nullptr;
+    size_t moved = list.count - keep;
+    if (keep == 0) {
+        last = first;
+        while (last->next) last = last->next;
+        list.head = nullptr;
+    } else {
+        FreeNode* tail_keep = list.head;
+        for (size_t i = 1; i < keep; ++i) tail_keep = tail_keep->next;
+        first = tail_keep->next;
+        last = first;
+        while (last->next) last = last->next;
+        tail_keep->next = nullptr;
+    }
+    list.count = keep;
+
+    std::lock_guard<std::mutex> lock(mu_);
+    FreeList& depot = depot_[cls];
+    last->next = depot.head;
+    depot.head = first;
+    depot.count += moved;
+}
+
+void UcxBufferPool::carve_locked(FreeList& list, uint32_t cls) {
+    size_t bytes = class_bytes(cls);
+    size_t align = std::min<size_t>(bytes, 4096);
+    Arena* a = arenas_.back().get();
+    size_t off = (a->used + align - 1) & ~(align - 1);
+    if (off + bytes > a->len) {
+        map_arena_locked();
+        a = arenas_.back().get();
+        off = 0;
+    }
+    size_t n = std::min(cfg_.batch, (a->len - off) / bytes);
+    ucp_mem_h memh = a->mem.memh();
+    for (size_t i = 0; i < n; ++i) {
+        auto* node = reinterpret_cast<FreeNode*>(a->base + off + i * bytes);
+        node->memh = memh;
+        node->next = list.head;
+        list.head = node;
+        ++list.count;
+    }
+    a->used = off + n * bytes;
+}
+
+void UcxBufferPool::map_arena_locked() {
+    if (cfg_.max_arenas && arenas_.size() >= cfg_.max_arenas)
+        throw std::runtime_error("UcxBufferPool: arena limit reached");
+    void* p = ::mmap(nullptr, cfg_.arena_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) throw std::runtime_error("UcxBufferPool: mmap failed");
+    std::unique_ptr<Arena> a(new Arena);
+    a->base = static_cast<char*>(p);
+    a->len = cfg_.arena_bytes;
+    try {
+        a->mem = UcxMem(ctx_, p, cfg_.arena_bytes);
+    } catch (...) {
+        ::munmap(p, cfg_.arena_bytes);
+        throw;
+    }
+    arenas_.push_back(std::move(a));
+}
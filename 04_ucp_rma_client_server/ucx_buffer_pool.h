@@ -0,0 +1,117 @@
+// Pre-registered transfer buffer pool built on UcxMem.
+// Standalone: depends only on UCX and ucx_util.
+
+#pragma once
+
+#include "ucx_util.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// UcxBuffer:
+// - A sub-buffer handed out by UcxBufferPool together with the memh of the
+//   arena it lives in, ready for UCP_OP_ATTR_FIELD_MEMH.
+struct UcxBuffer {
+    void* ptr{nullptr};
+    size_t capacity{0};
+    ucp_mem_h memh{nullptr};
+    uint32_t size_class{0};
+
+    explicit operator bool() const { return ptr != nullptr; }
+};
+
+// UcxBufferPool:
+// - Slab allocator over a few large arenas, each registered once through
+//   UcxMem. Requests are rounded up to power-of-two size classes.
+// - Every thread gets a private free list per size class, so alloc/free never
+//   take a lock or call ucp_mem_map on the hot path. Lists refill from and
+//   spill to a shared per-class depot in batches; the depot carves new slabs
+//   from the current arena and maps another arena only when that one is full.
+// - Buffers cached by a thread stay with it until flush_thread_cache() or
+//   until the thread exits, when its cache is spilled to the depot and
+//   dropped. The pool must outlive every buffer and the owning context must
+//   outlive the pool; threads may outlive it.
+class UcxBufferPool {
+public:
+    struct Config {
+        size_t arena_bytes{size_t(64) << 20}; // bytes per registered arena
+        size_t max_arenas{16};                // 0 = unlimited
+        size_t min_class{64};                 // smallest size class (power of two)
+        size_t max_class{size_t(1) << 20};    // largest size class (power of two)
+        size_t batch{32};                     // buffers moved per depot refill/spill
+    };
+    struct Stats {
+        size_t arenas{0};
+        size_t mapped_bytes{0};
+        uint64_t refills{0};
+        uint64_t spills{0};
+    };
+
+    UcxBufferPool(ucp_context_h ctx, const Config& cfg);
+    explicit UcxBufferPool(ucp_context_h ctx) : UcxBufferPool(ctx, Config()) {}
+    ~UcxBufferPool();
+    UcxBufferPool(const UcxBufferPool&) = delete;
+    UcxBufferPool& operator=(const UcxBufferPool&) = delete;
+
+    // Returns a buffer with capacity >= len. Throws if len exceeds max_class or
+    // the arena limit is reached.
+    UcxBuffer alloc(size_t len);
+    void free(const UcxBuffer& buf);
+
+    // Returns the calling thread's cached buffers to the shared depot.
+    void flush_thread_cache();
+
+    Stats stats() const;
+
+private:
+    // Lives inside a free buffer.
+    struct FreeNode {
+        FreeNode* next;
+        ucp_mem_h memh;
+    };
+    struct FreeList {
+        FreeNode* head{nullptr};
+        size_t count{0};
+    };
+    struct ThreadCache {
+        std::vector<FreeList> lists;
+    };
+    // Shared by the pool and every thread that cached buffers from it; pool
+    // is cleared (under mu) when the pool is destroyed.
+    struct Link {
+        std::mutex mu;
+        UcxBufferPool* pool{nullptr};
+    };
+    struct ThreadCaches; // thread_local holder; its destructor retires the caches
+    struct Arena {
+        char* base{nullptr};
+        size_t len{0};
+        size_t used{0};
+        UcxMem mem;
+    };
+
+    uint32_t class_of(size_t len) const;
+    size_t class_bytes(uint32_t cls) const { return cfg_.min_class << cls; }
+    ThreadCache& local_cache();
+    void retire_cache(ThreadCache* tc);
+    void refill(FreeList& list, uint32_t cls);
+    void spill(FreeList& list, uint32_t cls, size_t keep);
+    void carve_locked(FreeList& list, uint32_t cls);
+    void map_arena_locked();
+
+    ucp_context_h ctx_{nullptr};
+    Config cfg_;
+    uint32_t nclasses_{0};
+    std::shared_ptr<Link> link_;
+
+    mutable std::mutex mu_; // guards everything below
+    std::vector<std::unique_ptr<Arena>> arenas_;
+    std::vector<FreeList> depot_;
+    std::vector<std::unique_ptr<ThreadCache>> caches_;
+    std::atomic<uint64_t> refills_{0};
+    std::atomic<uint64_t> spills_{0};
+};
@@ -0,0 +1,229 @@
+// C++20 coroutine front-end for UcxEndpoint RMA operations.
+// Header-only; requires a C++20 compiler (the rest of the demo stays C++14).
+
+#pragma once
+
+#include "ucx_util.h"
+
+#if !defined(__cpp_impl_coroutine)
+#error "ucx_coro.h requires C++20 coroutine support"
+#endif
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <utility>
+#include <vector>
+
+namespace ucx_coro {
+
+class Scheduler;
+
+// Task:
+// - Lazily started coroutine returning void. Either co_await it from another
+//   task or hand it to Scheduler::spawn to run as a root task.
+// - Exceptions propagate to the awaiting task, or out of Scheduler::run for
+//   root tasks.
+class Task {
+public:
+    struct promise_type {
+        std::coroutine_handle<> continuation;
+        Scheduler* sched{nullptr}; // set for root tasks
+        std::exception_ptr error;
+
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+        struct FinalAwaiter {
+            bool await_ready() noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept;
+            void await_resume() noexcept {}
+        };
+        FinalAwaiter final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { error = std::current_exception(); }
+    };
+
+    Task(Task&& other) noexcept : h_(std::exchange(other.h_, {})) {}
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            if (h_) h_.destroy();
+            h_ = std::exchange(other.h_, {});
+        }
+        return *this;
+    }
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    ~Task() {
+        if (h_) h_.destroy();
+    }
+
+    // Awaiting a task starts it and resumes the awaiter when it finishes.
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept {
+        h_.promise().continuation = awaiter;
+        return h_;
+    }
+    void await_resume() {
+        if (h_.promise().error) std::rethrow_exception(h_.promise().error);
+    }
+
+private:
+    friend class Scheduler;
+    explicit Task(std::coroutine_handle<promise_type> h) : h_(h) {}
+    std::coroutine_handle<promise_type> release() { return std::exchange(h_, {}); }
+
+    std::coroutine_handle<promise_type> h_;
+};
+
+// Scheduler:
+// - Runs any number of root tasks on one UCX worker from a single thread.
+//   Suspended transfers cost one coroutine frame each; completions are
+//   delivered by UCX callbacks, which only queue the waiting coroutine, and
+//   run() resumes queued coroutines between ucp_worker_progress calls.
+class Scheduler {
+public:
+    explicit Scheduler(const UcxEnv& env) : worker_(env.worker()) {}
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+    ~Scheduler() {
+        for (auto h : roots_) h.destroy();
+    }
+
+    ucp_worker_h worker() const { return worker_; }
+
+    void spawn(Task task) {
+        auto h = task.release();
+        h.promise().sched = this;
+        roots_.push_back(h);
+        ++live_;
+        ready_.push_back(h);
+    }
+
+    // Queues a coroutine to be resumed by run().
+    void schedule(std::coroutine_handle<> h) { ready_.push_back(h); }
+
+    // Drives ready coroutines and worker progress until every root task has
+    // finished. Rethrows the first exception escaping a root task.
+    void run() {
+        while (live_ > 0) {
+            while (!ready_.empty()) {
+                auto h = ready_.front();
+                ready_.pop_front();
+                h.resume();
+            }
+            if (live_ > 0) ucp_worker_progress(worker_);
+        }
+        std::exception_ptr first;
+        for (auto h : roots_) {
+            if (!first && h.promise().error) first = h.promise().error;
+            h.destroy();
+        }
+        roots_.clear();
+        if (first) std::rethrow_exception(first);
+    }
+
+private:
+    friend struct Task::promise_type::FinalAwaiter;
+    void root_done() { --live_; }
+
+    ucp_worker_h worker_{nullptr};
+    std::deque<std::coroutine_handle<>> ready_;
+    std::vector<std::coroutine_handle<Task::promise_type>> roots_;
+    size_t live_{0};
+};
+
+inline std::coroutine_handle<> Task::promise_type::FinalAwaiter::await_suspend(
+    std::coroutine_handle<promise_type> h) noexcept {
+    promise_type& p = h.promise();
+    if (p.continuation) return p.continuation;
+    if (p.sched) p.sched->root_done(); // frame is destroyed by the scheduler
+    return std::noop_coroutine();
+}
+
+// RmaAwaitable:
+// - One put/get/flush posted when the awaiting coroutine suspends. Immediate
+//   completion resumes without suspending; otherwise the send callback queues
+//   the coroutine on the scheduler. co_await yields the ucs_status_t.
+class RmaAwaitable {
+public:
+    enum class Kind { Put, Get, Flush };
+
+    RmaAwaitable(Scheduler& sched, const UcxEndpoint& ep, Kind kind, void* laddr, size_t len, uint64_t raddr,
+                 ucp_rkey_h rkey, ucp_mem_h memh)
+        : sched_(&sched), ep_(&ep), kind_(kind), laddr_(laddr), len_(len), raddr_(raddr), rkey_(rkey),
+          memh_(memh) {}
+
+    bool await_ready() const noexcept { return false; }
+
+    bool await_suspend(std::coroutine_handle<> h) {
+        h_ = h;
+        ucp_request_param_t param{};
+        param.op_attr_mask = UCP_OP_ATTR_FIELD_CALLBACK | UCP_OP_ATTR_FIELD_USER_DATA;
+        param.cb.send = &RmaAwaitable::send_cb;
+        param.user_data = this;
+        if (memh_ && kind_ != Kind::Flush) {
+            param.op_attr_mask |= UCP_OP_ATTR_FIELD_MEMH;
+            param.memh = memh_;
+        }
+        void* req = nullptr;
+        switch (kind_) {
+            case Kind::Put: req = ep_->put_nbx(laddr_, len_, raddr_, rkey_, &param); break;
+            case Kind::Get: req = ep_->get_nbx(laddr_, len_, raddr_, rkey_, &param); break;
+            case Kind::Flush: req = ep_->flush_nbx(&param); break;
+        }
+        if (req == nullptr) return false; // completed in place
+        if (UCS_PTR_IS_ERR(req)) {
+            status_ = UCS_PTR_STATUS(req);
+            return false;
+        }
+        return true; // resumed from send_cb via the scheduler
+    }
+
+    ucs_status_t await_resume() const noexcept { return status_; }
+
+private:
+    static void send_cb(void* request, ucs_status_t status, void* user_data) {
+        auto* self = static_cast<RmaAwaitable*>(user_data);
+        self->status_ = status;
+        ucp_request_free(request);
+        self->sched_->schedule(self->h_);
+    }
+
+    Scheduler* sched_;
+    const UcxEndpoint* ep_;
+    Kind kind_;
+    void* laddr_;
+    size_t len_;
+    uint64_t raddr_;
+    ucp_rkey_h rkey_;
+    ucp_mem_h memh_;
+    std::coroutine_handle<> h_;
+    ucs_status_t status_{UCS_OK};
+};
+
+// Endpoint:
+// - Awaitable view of a UcxEndpoint bound to a scheduler:
+//     ucs_status_t st = co_await cep.put(buf, len, raddr, rkey, memh);
+class Endpoint {
+public:
+    Endpoint(Scheduler& sched, const UcxEndpoint& ep) : sched_(&sched), ep_(&ep) {}
+
+    RmaAwaitable put(const void* laddr, size_t len, uint64_t raddr, ucp_rkey_h rkey, ucp_mem_h memh = nullptr) const {
+        return RmaAwaitable(*sched_, *ep_, RmaAwaitable::Kind::Put, const_cast<void*>(laddr), len, raddr, rkey, memh);
+    }
+    RmaAwaitable get(void* laddr, size_t len, uint64_t raddr, ucp_rkey_h rkey, ucp_mem_h memh = nullptr) const {
+        return RmaAwaitable(*sched_, *ep_, RmaAwaitable::Kind::Get, laddr, len, raddr, rkey, memh);
+    }
+    RmaAwaitable flush() const {
+        return RmaAwaitable(*sched_, *ep_, RmaAwaitable::Kind::Flush, nullptr, 0, 0, nullptr, nullptr);
+    }
+
+private:
+    Scheduler* sched_;
+    const UcxEndpoint* ep_;
+};
+
+} // namespace ucx_coro
@@ -0,0 +1,189 @@
+#include "ucx_region.h"
+#include "ucx_util.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+const size_t kHugePageSize = size_t(2) << 20; // x86-64/aarch64 default PMD size
+const size_t kInitSliceBytes = size_t(64) << 20; // auto threads: one per 64 MiB
+const int kMpolBind = 2; // MPOL_BIND from <numaif.h>, without linking libnuma
+
+size_t round_up(size_t v, size_t a) {
+    return (v + a - 1) / a * a;
+}
+
+void bind_to_node(void* addr, size_t len, int node) {
+#ifdef SYS_mbind
+    std::vector<unsigned long> mask(static_cast<size_t>(node) / (8 * sizeof(unsigned long)) + 1, 0);
+    mask[static_cast<size_t>(node) / (8 * sizeof(unsigned long))] = 1ul << (node % (8 * sizeof(unsigned long)));
+    unsigned long maxnode = mask.size() * 8 * sizeof(unsigned long);
+    if (::syscall(SYS_mbind, addr, len, kMpolBind, mask.data(), maxnode, 0) != 0)
+        throw std::runtime_error("mbind(node " + std::to_string(node) + "): " + std::strerror(errno));
+#else
+    (void)addr;
+    (void)len;
+    (void)node;
+    throw std::runtime_error("NUMA binding is not supported on this platform");
+#endif
+}
+
+} // namespace
+
+bool parse_alloc_option(const char* arg, AllocOptions& opts) {
+    const char* v = nullptr;
+    if ((v = cli::opt_value(arg, "--hugepages"))) {
+        if (std::strcmp(v, "none") == 0) opts.hugepages = HugePages::None;
+        else if (std::strcmp(v, "thp") == 0) opts.hugepages = HugePages::Transparent;
+        else if (std::strcmp(v, "explicit") == 0) opts.hugepages = HugePages::Explicit;
+        else throw std::invalid_argument(std::string("--hugepages must be none, thp or explicit: ") + v);
+    } else if ((v = cli::opt_value(arg, "--numa"))) {
+        opts.numa_node = std::atoi(v);
+    } else if ((v = cli::opt_value(arg, "--init-threads"))) {
+        opts.init_threads = static_cast<unsigned>(std::strtoul(v, nullptr, 10));
+    } else {
+        return false;
+    }
+    return true;
+}
+
+RegionMemory::~RegionMemory() {
+    if (addr_) ::munmap(addr_, map_len_);
+}
+
+RegionMemory::RegionMemory(RegionMemory&& other) noexcept {
+    *this = std::move(other);
+}
+
+RegionMemory& RegionMemory::operator=(RegionMemory&& other) noexcept {
+    if (this != &other) {
+        if (addr_) ::munmap(addr_, map_len_);
+        addr_ = other.addr_;
+        len_ = other.len_;
+        map_len_ = other.map_len_;
+        hugepages_ = other.hugepages_;
+        read_only_ = other.read_only_;
+        path_ = std::move(other.path_);
+        other.addr_ = nullptr;
+        other.len_ = 0;
+        other.map_len_ = 0;
+        other.hugepages_ = HugePages::None;
+        other.read_only_ = false;
+        other.path_.clear();
+    }
+    return *this;
+}
+
+RegionMemory RegionMemory::anonymous(size_t len, const AllocOptions& opts) {
+    RegionMemory m;
+    if (len == 0) return m;
+    const int prot = PROT_READ | PROT_WRITE;
+    const int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    void* p = MAP_FAILED;
+    size_t map_len = len;
+    switch (opts.hugepages) {
+        case HugePages::None:
+            p = ::mmap(nullptr, len, prot, flags, -1, 0);
+            break;
+        case HugePages::Transparent: {
+            // Over-map and trim so the region starts on a hugepage boundary;
+            // otherwise the head and tail of every 2 MiB extent stay 4K pages.
+            map_len = round_up(len, kHugePageSize);
+            void* raw = ::mmap(nullptr, map_len + kHugePageSize, prot, flags, -1, 0);
+            if (raw == MAP_FAILED) break;
+            uintptr_t start = round_up(reinterpret_cast<uintptr_t>(raw), kHugePageSize);
+            size_t head = start - reinterpret_cast<uintptr_t>(raw);
+            if (head) ::munmap(raw, head);
+            if (kHugePageSize - head) ::munmap(reinterpret_cast<char*>(start) + map_len, kHugePageSize - head);
+            p = reinterpret_cast<void*>(start);
+#ifdef MADV_HUGEPAGE
+            ::madvise(p, map_len, MADV_HUGEPAGE); // best effort: THP may be disabled system-wide
+#endif
+            break;
+        }
+        case HugePages::Explicit:
+#ifdef MAP_HUGETLB
+            map_len = round_up(len, kHugePageSize);
+            p = ::mmap(nullptr, map_len, prot, flags | MAP_HUGETLB, -1, 0);
+            if (p == MAP_FAILED)
+                throw std::runtime_error("mmap(MAP_HUGETLB, " + std::to_string(map_len) +
+                                         "): " + std::strerror(errno) + " (reserve pages via vm.nr_hugepages)");
+#else
+            throw std::runtime_error("explicit hugepages are not supported on this platform");
+#endif
+            break;
+    }
+    if (p == MAP_FAILED) throw std::runtime_error("mmap(anonymous) failed");
+    m.addr_ = p;
+    m.len_ = len;
+    m.map_len_ = map_len;
+    m.hugepages_ = opts.hugepages;
+    // Nothing is faulted in yet, so the policy applies to every page.
+    if (opts.numa_node >= 0) bind_to_node(p, map_len, opts.numa_node);
+    return m;
+}
+
+RegionMemory RegionMemory::file(const std::string& path, const FileMapOptions& opts) {
+    int fd = ::open(path.c_str(), opts.writable ? O_RDWR : O_RDONLY);
+    if (fd < 0) throw std::runtime_error("open(" + path + "): " + std::strerror(errno));
+    struct stat st{};
+    if (::fstat(fd, &st) < 0 || st.st_size <= 0) {
+        ::close(fd);
+        throw std::runtime_error("file region " + path + " is empty or cannot be stat'ed");
+    }
+    size_t len = static_cast<size_t>(st.st_size);
+    int prot = opts.writable ? PROT_READ | PROT_WRITE : PROT_READ;
+    int flags = MAP_SHARED;
+#ifdef MAP_POPULATE
+    if (opts.populate) flags |= MAP_POPULATE;
+#endif
+    void* p = ::mmap(nullptr, len, prot, flags, fd, 0);
+    int err = errno;
+    ::close(fd); // the mapping keeps the file referenced
+    if (p == MAP_FAILED) throw std::runtime_error("mmap(" + path + "): " + std::strerror(err));
+#ifdef MADV_HUGEPAGE
+    if (opts.hugepages) ::madvise(p, len, MADV_HUGEPAGE); // best effort
+#endif
+
+    RegionMemory m;
+    m.addr_ = p;
+    m.len_ = len;
+    m.map_len_ = len;
+    m.read_only_ = !opts.writable;
+    m.path_ = path;
+    return m;
+}
+
+void RegionMemory::parallel_init(unsigned threads, const std::function<void(char*, size_t, size_t)>& fn) {
+    if (len_ == 0) return;
+    if (threads == 0) {
+        unsigned ncpu = std::max(1u, std::thread::hardware_concurrency());
+        threads = static_cast<unsigned>(std::min<size_t>(ncpu, std::max<size_t>(1, len_ / kInitSliceBytes)));
+    }
+    // Slices are whole hugepages so no page is faulted by two threads.
+    size_t slice = round_up((len_ + threads - 1) / threads, kHugePageSize);
+    std::vector<std::thread> pool;
+    for (size_t off = slice; off < len_; off += slice)
+        pool.emplace_back([&, off]() { fn(data() + off, off, std::min(slice, len_ - off)); });
+    fn(data(), 0, std::min(slice, len_)); // first slice on the calling thread
+    for (std::thread& t : pool) t.join();
+}
+
+void RegionMemory::prefault(unsigned threads) {
+    const size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    parallel_init(threads, [page](char* p, size_t, size_t n) {
+        for (size_t i = 0; i < n; i += page) *reinterpret_cast<volatile char*>(p + i) = p[i];
+    });
+}
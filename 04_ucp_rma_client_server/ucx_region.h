@@ -0,0 +1,77 @@
+// Backing memory for server regions and large client buffers.
+// - Anonymous regions: private zeroed mmap of the requested size, optionally
+//   on transparent or explicit (hugetlb) hugepages and bound to a NUMA node.
+// - File regions: mmap of a whole file, so RMA GETs are served straight from
+//   the page cache with no copy into the process heap. Read-only by default
+//   (PROT_READ, MAP_SHARED); register such mappings with UcxMem::kReadOnly.
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+enum class HugePages {
+    None,
+    Transparent, // 2 MiB-aligned mapping + madvise(MADV_HUGEPAGE)
+    Explicit,    // MAP_HUGETLB from the reserved pool (vm.nr_hugepages)
+};
+
+struct AllocOptions {
+    HugePages hugepages{HugePages::None};
+    int numa_node{-1};       // >= 0: mbind(MPOL_BIND) the mapping to this node before first touch
+    unsigned init_threads{0}; // threads touching/initializing the region; 0 = auto by size
+};
+
+// Parses --hugepages=<none|thp|explicit>, --numa=<node> and --init-threads=<n>
+// into opts. Returns false if arg is none of them; throws on a bad value.
+bool parse_alloc_option(const char* arg, AllocOptions& opts);
+
+struct FileMapOptions {
+    bool writable{false}; // PROT_READ|PROT_WRITE, MAP_SHARED: remote PUTs land in the file
+    bool populate{false}; // MAP_POPULATE: fault in (read ahead) the whole file before serving
+    bool hugepages{false}; // madvise(MADV_HUGEPAGE); only effective where the kernel supports file THP
+};
+
+class RegionMemory {
+public:
+    RegionMemory() = default;
+    ~RegionMemory();
+    RegionMemory(const RegionMemory&) = delete;
+    RegionMemory& operator=(const RegionMemory&) = delete;
+    RegionMemory(RegionMemory&& other) noexcept;
+    RegionMemory& operator=(RegionMemory&& other) noexcept;
+
+    // Zeroed anonymous mapping of len bytes, not yet faulted in. Throws on
+    // failure (e.g. no reserved hugepages or an invalid NUMA node).
+    static RegionMemory anonymous(size_t len, const AllocOptions& opts = AllocOptions());
+    // Maps all of `path`. Throws if the file cannot be opened, is empty or
+    // cannot be mapped.
+    static RegionMemory file(const std::string& path, const FileMapOptions& opts);
+
+    char* data() const { return static_cast<char*>(addr_); }
+    size_t size() const { return len_; }
+    bool read_only() const { return read_only_; }
+    bool file_backed() const { return !path_.empty(); }
+    const std::string& path() const { return path_; }
+
+    // Runs fn(ptr, offset, n) over [0, size()) split into contiguous,
+    // hugepage-aligned slices, one per thread, so page faults and the initial
+    // fill run in parallel (and first-touch lands on each thread's node when
+    // no binding is set). threads == 0 picks one per 64 MiB, up to the CPU count.
+    void parallel_init(unsigned threads, const std::function<void(char*, size_t, size_t)>& fn);
+    // Faults every page in with parallel_init, without changing contents.
+    // Writable mappings only.
+    void prefault(unsigned threads);
+
+    // Hugepage mode the mapping was created with.
+    HugePages hugepages() const { return hugepages_; }
+
+private:
+    void* addr_{nullptr};
+    size_t len_{0};
+    size_t map_len_{0}; // mapped length (len_ rounded up to the hugepage size)
+    HugePages hugepages_{HugePages::None};
+    bool read_only_{false};
+    std::string path_;
+};
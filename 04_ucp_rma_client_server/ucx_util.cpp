@@ -6,7 +6,10 @@
 #include <sys/socket.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <cstdlib>
 #include <cstring>
+#include <iterator>
 #include <stdexcept>
 
 namespace tcp {
@@ -15,6 +18,13 @@ static void die(const char* msg) {
     throw std::runtime_error(msg);
 }
 
+// A peer that hung up must surface as an error, not kill the process.
+#ifdef MSG_NOSIGNAL
+static const int kSendFlags = MSG_NOSIGNAL;
+#else
+static const int kSendFlags = 0;
+#endif
+
 int listen(uint16_t port) {
     int fd = ::socket(AF_INET, SOCK_STREAM, 0);
     if (fd < 0) die("socket()");
@@ -54,7 +64,7 @@ void send_all(int fd, const void* buf, size_t len) {
     const char* p = static_cast<const char*>(buf);
     size_t off = 0;
     while (off < len) {
-        ssize_t n = ::send(fd, p + off, len - off, 0);
+        ssize_t n = ::send(fd, p + off, len - off, kSendFlags);
         if (n <= 0) die("send()");
         off += static_cast<size_t>(n);
     }
@@ -70,37 +80,387 @@ void recv_all(int fd, void* buf, size_t len) {
     }
 }
 
+void writev_all(int fd, struct iovec* iov, int iovcnt) {
+    while (iovcnt > 0) {
+        ssize_t n = ::writev(fd, iov, iovcnt);
+        if (n <= 0) die("writev()");
+        size_t left = static_cast<size_t>(n);
+        while (iovcnt > 0 && left >= iov->iov_len) {
+            left -= iov->iov_len;
+            ++iov;
+            --iovcnt;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + left;
+            iov->iov_len -= left;
+        }
+    }
+}
+
 } // namespace tcp
 
-void Handshake::send_fd(int fd) const {
-    uint32_t wlen32 = static_cast<uint32_t>(worker_addr.size());
-    uint32_t rlen32 = static_cast<uint32_t>(rkey.size());
-    tcp::send_all(fd, &wlen32, sizeof(wlen32));
-    if (!worker_addr.empty()) tcp::send_all(fd, worker_addr.data(), worker_addr.size());
-    tcp::send_all(fd, &rlen32, sizeof(rlen32));
-    if (!rkey.empty()) tcp::send_all(fd, rkey.data(), rkey.size());
-    tcp::send_all(fd, &remote_addr, sizeof(remote_addr));
-    tcp::send_all(fd, &size, sizeof(size));
+namespace cli {
+
+const char* opt_value(const char* arg, const char* name) {
+    size_t n = std::strlen(name);
+    if (std::strncmp(arg, name, n) != 0 || arg[n] != '=') return nullptr;
+    return arg + n + 1;
 }
 
-Handshake Handshake::recv_fd(int fd) {
+bool is_flag(const char* arg, const char* name) {
+    return std::strcmp(arg, name) == 0;
+}
+
+size_t parse_size(const char* s) {
+    char* end = nullptr;
+    unsigned long long v = std::strtoull(s, &end, 10);
+    if (end == s) throw std::invalid_argument(std::string("invalid size: ") + s);
+    switch (*end) {
+        case 'k': case 'K': v <<= 10; break;
+        case 'm': case 'M': v <<= 20; break;
+        case 'g': case 'G': v <<= 30; break;
+        case '\0': break;
+        default: throw std::invalid_argument(std::string("invalid size suffix: ") + s);
+    }
+    return static_cast<size_t>(v);
+}
+
+std::vector<size_t> parse_size_list(const char* s) {
+    std::vector<size_t> out;
+    std::string item;
+    for (const char* p = s;; ++p) {
+        if (*p == ',' || *p == '\0') {
+            if (!item.empty()) out.push_back(parse_size(item.c_str()));
+            item.clear();
+            if (*p == '\0') break;
+        } else {
+            item += *p;
+        }
+    }
+    return out;
+}
+
+} // namespace cli
+
+namespace {
+
+const uint32_t kCrc32cPoly = 0x82f63b78u; // reflected Castagnoli polynomial
+
+struct Crc32cTable {
+    uint32_t t[256];
+    Crc32cTable() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? (c >> 1) ^ kCrc32cPoly : (c >> 1);
+            t[i] = c;
+        }
+    }
+};
+
+// Raw (non-inverted) CRC register update, portable fallback.
+uint32_t crc32c_sw(uint32_t crc, const unsigned char* p, size_t len) {
+    static const Crc32cTable table;
+    for (size_t i = 0; i < len; ++i) crc = table.t[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    return crc;
+}
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define UCX_UTIL_CRC32C_HW 1
+
+// Appending n zero bytes to a CRC register is a linear map over GF(2). A
+// ZeroShift holds it as four byte-indexed tables, so the register of
+// A||B can be formed from independently computed registers of A and B.
+struct ZeroShift {
+    uint32_t t[4][256];
+
+    explicit ZeroShift(size_t n) {
+        // Columns of the one-zero-bit operator, then square up to n bytes.
+        uint32_t op[32], sq[32];
+        op[0] = kCrc32cPoly;
+        for (int i = 1; i < 32; ++i) op[i] = 1u << (i - 1);
+        uint32_t acc[32]; // identity
+        for (int i = 0; i < 32; ++i) acc[i] = 1u << i;
+        size_t bits = n * 8;
+        while (bits) {
+            if (bits & 1) compose(acc, op, acc);
+            compose(op, op, sq);
+            std::memcpy(op, sq, sizeof(op));
+            bits >>= 1;
+        }
+        for (int k = 0; k < 4; ++k)
+            for (uint32_t b = 0; b < 256; ++b) t[k][b] = apply(acc, b << (8 * k));
+    }
+
+    uint32_t operator()(uint32_t crc) const {
+        return t[0][crc & 0xFF] ^ t[1][(crc >> 8) & 0xFF] ^ t[2][(crc >> 16) & 0xFF] ^ t[3][crc >> 24];
+    }
+
+private:
+    static uint32_t apply(const uint32_t* m, uint32_t v) {
+        uint32_t r = 0;
+        for (int i = 0; v; ++i, v >>= 1)
+            if (v & 1) r ^= m[i];
+        return r;
+    }
+    // out = a * b (apply b first, then a); out may alias b.
+    static void compose(const uint32_t* a, const uint32_t* b, uint32_t* out) {
+        uint32_t tmp[32];
+        for (int i = 0; i < 32; ++i) tmp[i] = apply(a, b[i]);
+        std::memcpy(out, tmp, sizeof(tmp));
+    }
+};
+
+// Three interleaved streams hide the 3-cycle latency of the crc32
+// instruction (one issue per cycle); blocks are then stitched with ZeroShift.
+const size_t kLongBlock = 8192;
+const size_t kShortBlock = 256;
+
+struct Crc32cShifts {
+    ZeroShift long1{kLongBlock}, long2{2 * kLongBlock};
+    ZeroShift short1{kShortBlock}, short2{2 * kShortBlock};
+};
+
+__attribute__((target("sse4.2"))) inline uint64_t crc_u64(uint64_t crc, const unsigned char* p) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return __builtin_ia32_crc32di(crc, v);
+}
+
+__attribute__((target("sse4.2"))) uint32_t crc32c_3way(uint32_t crc, const unsigned char*& p, size_t& len,
+                                                        size_t block, const ZeroShift& shift1, const ZeroShift& shift2) {
+    while (len >= 3 * block) {
+        uint64_t a = crc, b = 0, c = 0;
+        const unsigned char* pb = p + block;
+        const unsigned char* pc = p + 2 * block;
+        for (size_t i = 0; i < block; i += 8) {
+            a = crc_u64(a, p + i);
+            b = crc_u64(b, pb + i);
+            c = crc_u64(c, pc + i);
+        }
+        crc = shift2(static_cast<uint32_t>(a)) ^ shift1(static_cast<uint32_t>(b)) ^ static_cast<uint32_t>(c);
+        p += 3 * block;
+        len -= 3 * block;
+    }
+    return crc;
+}
+
+__attribute__((target("sse4.2"))) uint32_t crc32c_hw(uint32_t crc, const unsigned char* p, size_t len) {
+    static const Crc32cShifts shifts;
+    crc = crc32c_3way(crc, p, len, kLongBlock, shifts.long1, shifts.long2);
+    crc = crc32c_3way(crc, p, len, kShortBlock, shifts.short1, shifts.short2);
+    uint64_t c = crc;
+    for (; len >= 8; p += 8, len -= 8) c = crc_u64(c, p);
+    crc = static_cast<uint32_t>(c);
+    for (; len; ++p, --len) crc = __builtin_ia32_crc32qi(crc, *p);
+    return crc;
+}
+#endif
+
+using Crc32cFn = uint32_t (*)(uint32_t, const unsigned char*, size_t);
+
+Crc32cFn select_crc32c() {
+#ifdef UCX_UTIL_CRC32C_HW
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2")) return crc32c_hw;
+#endif
+    return crc32c_sw;
+}
+
+Crc32cFn crc32c_fn() {
+    static const Crc32cFn fn = select_crc32c(); // function-local: safe from other static initializers
+    return fn;
+}
+
+} // namespace
+
+uint32_t crc32c(uint32_t crc, const void* data, size_t len) {
+    return ~crc32c_fn()(~crc, static_cast<const unsigned char*>(data), len);
+}
+
+const char* crc32c_impl() {
+    return crc32c_fn() == crc32c_sw ? "software" : "sse4.2";
+}
+
+const RegionDesc& Handshake::region(uint32_t id) const {
+    for (const RegionDesc& r : regions)
+        if (r.id == id) return r;
+    throw std::out_of_range("handshake has no region with id " + std::to_string(id));
+}
+
+namespace {
+
+void put_le16(std::vector<char>& out, uint16_t v) {
+    for (int i = 0; i < 2; ++i) out.push_back(static_cast<char>(v >> (8 * i)));
+}
+
+void put_le32(std::vector<char>& out, uint32_t v) {
+    for (int i = 0; i < 4; ++i) out.push_back(static_cast<char>(v >> (8 * i)));
+}
+
+void put_le64(std::vector<char>& out, uint64_t v) {
+    for (int i = 0; i < 8; ++i) out.push_back(static_cast<char>(v >> (8 * i)));
+}
+
+void put_bytes(std::vector<char>& out, const std::vector<char>& v) {
+    put_le32(out, static_cast<uint32_t>(v.size()));
+    out.insert(out.end(), v.begin(), v.end());
+}
+
+// Bounds-checked little-endian reader over a received frame.
+class LeReader {
+public:
+    LeReader(const char* p, size_t len) : p_(reinterpret_cast<const unsigned char*>(p)), len_(len) {}
+
+    uint64_t get(size_t nbytes) {
+        need(nbytes);
+        uint64_t v = 0;
+        for (size_t i = 0; i < nbytes; ++i) v |= static_cast<uint64_t>(p_[off_ + i]) << (8 * i);
+        off_ += nbytes;
+        return v;
+    }
+    uint16_t u16() { return static_cast<uint16_t>(get(2)); }
+    uint32_t u32() { return static_cast<uint32_t>(get(4)); }
+    uint64_t u64() { return get(8); }
+    std::vector<char> bytes() {
+        uint32_t n = u32();
+        need(n);
+        std::vector<char> v(p_ + off_, p_ + off_ + n);
+        off_ += n;
+        return v;
+    }
+    size_t remaining() const { return len_ - off_; }
+
+private:
+    void need(size_t n) const {
+        if (len_ - off_ < n) throw std::runtime_error("handshake: truncated frame");
+    }
+
+    const unsigned char* p_;
+    size_t len_;
+    size_t off_{0};
+};
+
+const uint32_t kMaxHandshakePayload = 64u << 20;
+
+std::vector<char> serialize_payload(const Handshake& hs) {
+    std::vector<char> out;
+    put_bytes(out, hs.worker_addr);
+    put_le32(out, static_cast<uint32_t>(hs.regions.size()));
+    for (const RegionDesc& r : hs.regions) {
+        put_le32(out, r.id);
+        put_le64(out, r.remote_addr);
+        put_le64(out, r.size);
+        put_bytes(out, r.rkey);
+    }
+    return out;
+}
+
+std::vector<char> serialize_header(const std::vector<char>& payload) {
+    std::vector<char> out;
+    out.reserve(Handshake::kHeaderLen);
+    put_le32(out, Handshake::kMagic);
+    put_le16(out, Handshake::kVersion);
+    put_le16(out, static_cast<uint16_t>(Handshake::kHeaderLen));
+    put_le32(out, static_cast<uint32_t>(payload.size()));
+    put_le32(out, crc32c(0, payload.data(), payload.size()));
+    return out;
+}
+
+// Validates the header and returns the payload length.
+uint32_t parse_header(const char* data, size_t len) {
+    LeReader rd(data, len);
+    if (rd.u32() != Handshake::kMagic) throw std::runtime_error("handshake: bad magic");
+    uint16_t version = rd.u16();
+    if (version != Handshake::kVersion)
+        throw std::runtime_error("handshake: unsupported version " + std::to_string(version));
+    if (rd.u16() != Handshake::kHeaderLen) throw std::runtime_error("handshake: bad header length");
+    uint32_t plen = rd.u32();
+    if (plen > kMaxHandshakePayload) throw std::runtime_error("handshake: payload too large");
+    return plen;
+}
+
+} // namespace
+
+std::vector<char> Handshake::serialize() const {
+    std::vector<char> payload = serialize_payload(*this);
+    std::vector<char> out = serialize_header(payload);
+    out.insert(out.end(), payload.begin(), payload.end());
+    return out;
+}
+
+Handshake Handshake::deserialize(const char* data, size_t len) {
+    if (len < kHeaderLen) throw std::runtime_error("handshake: truncated frame");
+    uint32_t plen = parse_header(data, len);
+    if (len - kHeaderLen != plen) throw std::runtime_error("handshake: length mismatch");
+    LeReader hdr(data + 12, 4);
+    const char* payload = data + kHeaderLen;
+    if (hdr.u32() != crc32c(0, payload, plen)) throw std::runtime_error("handshake: crc mismatch");
+
     Handshake hs;
-    uint32_t wlen32 = 0, rlen32 = 0;
-    tcp::recv_all(fd, &wlen32, sizeof(wlen32));
-    hs.worker_addr.resize(wlen32);
-    if (wlen32) tcp::recv_all(fd, hs.worker_addr.data(), hs.worker_addr.size());
-    tcp::recv_all(fd, &rlen32, sizeof(rlen32));
-    hs.rkey.resize(rlen32);
-    if (rlen32) tcp::recv_all(fd, hs.rkey.data(), hs.rkey.size());
-    tcp::recv_all(fd, &hs.remote_addr, sizeof(hs.remote_addr));
-    tcp::recv_all(fd, &hs.size, sizeof(hs.size));
+    LeReader rd(payload, plen);
+    hs.worker_addr = rd.bytes();
+    uint32_t nreg = rd.u32();
+    // Each region takes at least 24 bytes; reject counts the frame can't hold.
+    if (nreg > rd.remaining() / 24) throw std::runtime_error("handshake: bad region count");
+    hs.regions.resize(nreg);
+    for (RegionDesc& r : hs.regions) {
+        r.id = rd.u32();
+        r.remote_addr = rd.u64();
+        r.size = rd.u64();
+        r.rkey = rd.bytes();
+    }
+    if (rd.remaining() != 0) throw std::runtime_error("handshake: trailing bytes");
     return hs;
 }
 
-UcxEnv::UcxEnv() {
+void Handshake::send_fd(int fd) const {
+    std::vector<char> payload = serialize_payload(*this);
+    std::vector<char> header = serialize_header(payload);
+    struct iovec iov[2];
+    iov[0].iov_base = header.data();
+    iov[0].iov_len = header.size();
+    iov[1].iov_base = payload.data();
+    iov[1].iov_len = payload.size();
+    tcp::writev_all(fd, iov, 2);
+}
+
+void Handshake::send_blob(int fd, const std::vector<char>& blob) {
+    tcp::send_all(fd, blob.data(), blob.size());
+}
+
+Handshake Handshake::recv_fd(int fd) {
+    // Read as much as is available; a handshake normally fits in the first read.
+    std::vector<char> buf(4096);
+    size_t have = 0;
+    size_t total = 0; // known once the header is in
+    while (total == 0 || have < total) {
+        if (have == buf.size()) buf.resize(buf.size() * 2);
+        ssize_t n = ::recv(fd, buf.data() + have, buf.size() - have, 0);
+        if (n <= 0) throw std::runtime_error("recv()");
+        have += static_cast<size_t>(n);
+        if (total == 0 && have >= kHeaderLen) {
+            total = kHeaderLen + parse_header(buf.data(), have);
+            if (buf.size() < total) buf.resize(total);
+        }
+    }
+    if (have > total) throw std::runtime_error("handshake: trailing bytes");
+    return deserialize(buf.data(), total);
+}
+
+// Runs once per request object when UCX first allocates it, not per reuse.
+static void request_state_init(void* request) {
+    static_cast<UcxRequestState*>(request)->id = 0;
+}
+
+UcxEnv::UcxEnv(const UcxEnvOptions& opts) {
     ucp_params_t ucp_params{};
-    ucp_params.field_mask = UCP_PARAM_FIELD_FEATURES;
-    ucp_params.features = UCP_FEATURE_RMA | UCP_FEATURE_AM;
+    ucp_params.field_mask = UCP_PARAM_FIELD_FEATURES | UCP_PARAM_FIELD_MT_WORKERS_SHARED |
+                            UCP_PARAM_FIELD_REQUEST_SIZE | UCP_PARAM_FIELD_REQUEST_INIT;
+    ucp_params.features = UCP_FEATURE_RMA | UCP_FEATURE_AMO32 | UCP_FEATURE_AMO64 | UCP_FEATURE_AM;
+    if (opts.wakeup) ucp_params.features |= UCP_FEATURE_WAKEUP;
+    ucp_params.mt_workers_shared = opts.mt_workers_shared ? 1 : 0;
+    ucp_params.request_size = sizeof(UcxRequestState);
+    ucp_params.request_init = request_state_init;
     ucp_config_t* config = nullptr;
     if (ucp_config_read(nullptr, nullptr, &config) != UCS_OK) throw std::runtime_error("ucp_config_read failed");
     if (ucp_init(&ucp_params, config, &ctx_) != UCS_OK) {
@@ -109,19 +469,30 @@ UcxEnv::UcxEnv() {
     }
     ucp_config_release(config);
 
-    ucp_worker_params_t worker_params{};
-    worker_params.field_mask = UCP_WORKER_PARAM_FIELD_THREAD_MODE;
-    worker_params.thread_mode = UCS_THREAD_MODE_MULTI;
-    if (ucp_worker_create(ctx_, &worker_params, &worker_) != UCS_OK) {
+    try {
+        create_worker(opts);
+    } catch (...) {
         ucp_cleanup(ctx_);
         ctx_ = nullptr;
-        throw std::runtime_error("ucp_worker_create failed");
+        throw;
     }
 }
 
+UcxEnv::UcxEnv(const UcxEnv& parent, const UcxEnvOptions& opts)
+    : ctx_(parent.ctx_), owns_ctx_(false) {
+    create_worker(opts);
+}
+
+void UcxEnv::create_worker(const UcxEnvOptions& opts) {
+    ucp_worker_params_t worker_params{};
+    worker_params.field_mask = UCP_WORKER_PARAM_FIELD_THREAD_MODE;
+    worker_params.thread_mode = opts.thread_mode;
+    if (ucp_worker_create(ctx_, &worker_params, &worker_) != UCS_OK) throw std::runtime_error("ucp_worker_create failed");
+}
+
 UcxEnv::~UcxEnv() {
     if (worker_) ucp_worker_destroy(worker_);
-    if (ctx_) ucp_cleanup(ctx_);
+    if (ctx_ && owns_ctx_) ucp_cleanup(ctx_);
 }
 
 std::vector<char> UcxEnv::worker_address_bytes() const {
@@ -136,8 +507,18 @@ std::vector<char> UcxEnv::worker_address_bytes() const {
     return out;
 }
 
-void UcxEnv::progress() const {
-    ucp_worker_progress(worker_);
+unsigned UcxEnv::progress() const {
+    return ucp_worker_progress(worker_);
+}
+
+int UcxEnv::event_fd() const {
+    int efd = -1;
+    if (ucp_worker_get_efd(worker_, &efd) != UCS_OK) throw std::runtime_error("ucp_worker_get_efd failed");
+    return efd;
+}
+
+ucs_status_t UcxEnv::arm() const {
+    return ucp_worker_arm(worker_);
 }
 
 ucs_status_t UcxEnv::wait(void* req) const {
@@ -151,17 +532,178 @@ ucs_status_t UcxEnv::wait(void* req) const {
     return st;
 }
 
-UcxMem::UcxMem(ucp_context_h ctx, void* base, size_t len)
+struct UcxRegCache::Region {
+    uintptr_t start{0};
+    uintptr_t end{0};
+    ucp_mem_h memh{nullptr};
+    size_t refs{0};
+    bool indexed{false};
+    bool idle{false}; // on lru_
+    std::list<Region*>::iterator lru_it;
+};
+
+static uintptr_t page_size() {
+    static const uintptr_t ps = static_cast<uintptr_t>(::sysconf(_SC_PAGESIZE));
+    return ps;
+}
+
+UcxRegCache::UcxRegCache(ucp_context_h ctx, size_t max_pinned_bytes)
+    : ctx_(ctx), max_pinned_(max_pinned_bytes) {}
+
+UcxRegCache::~UcxRegCache() {
+    std::lock_guard<std::mutex> lock(mu_);
+    while (!index_.empty()) {
+        Region* r = index_.begin()->second;
+        unindex_locked(r);
+        free_locked(r);
+    }
+}
+
+UcxRegCache::Region* UcxRegCache::acquire(void* base, size_t len) {
+    uintptr_t ps = page_size();
+    uintptr_t start = reinterpret_cast<uintptr_t>(base) & ~(ps - 1);
+    uintptr_t end = (reinterpret_cast<uintptr_t>(base) + (len ? len : 1) + ps - 1) & ~(ps - 1);
+
+    std::lock_guard<std::mutex> lock(mu_);
+    // Only the last range starting at or below `start` can cover it.
+    auto it = index_.upper_bound(start);
+    if (it != index_.begin()) {
+        Region* r = std::prev(it)->second;
+        if (r->start <= start && end <= r->end) {
+            if (r->idle) {
+                lru_.erase(r->lru_it);
+                r->idle = false;
+            }
+            ++r->refs;
+            ++hits_;
+            return r;
+        }
+        if (r->end > start) it = std::prev(it);
+    }
+
+    // Miss: fold every overlapping cached range into one new registration.
+    uintptr_t mstart = start, mend = end;
+    while (it != index_.end() && it->second->start < end) {
+        Region* r = (it++)->second;
+        mstart = std::min(mstart, r->start);
+        mend = std::max(mend, r->end);
+        unindex_locked(r);
+        if (r->refs == 0) free_locked(r);
+    }
+
+    ucp_mem_map_params_t mpar{};
+    mpar.field_mask = UCP_MEM_MAP_PARAM_FIELD_ADDRESS | UCP_MEM_MAP_PARAM_FIELD_LENGTH;
+    mpar.address = reinterpret_cast<void*>(mstart);
+    mpar.length = mend - mstart;
+    ucp_mem_h memh = nullptr;
+    if (ucp_mem_map(ctx_, &mpar, &memh) != UCS_OK) throw std::runtime_error("ucp_mem_map failed");
+
+    Region* r = new Region;
+    r->start = mstart;
+    r->end = mend;
+    r->memh = memh;
+    r->refs = 1;
+    r->indexed = true;
+    index_.emplace(mstart, r);
+    pinned_ += mend - mstart;
+    ++misses_;
+    evict_locked();
+    return r;
+}
+
+void UcxRegCache::release(Region* region) {
+    if (region == nullptr) return;
+    std::lock_guard<std::mutex> lock(mu_);
+    if (--region->refs > 0) return;
+    if (!region->indexed) {
+        free_locked(region);
+        return;
+    }
+    region->lru_it = lru_.insert(lru_.end(), region);
+    region->idle = true;
+    evict_locked();
+}
+
+ucp_mem_h UcxRegCache::memh(const Region* region) {
+    return region ? region->memh : nullptr;
+}
+
+void UcxRegCache::invalidate(void* base, size_t len) {
+    uintptr_t start = reinterpret_cast<uintptr_t>(base);
+    uintptr_t end = start + len;
+    std::lock_guard<std::mutex> lock(mu_);
+    auto it = index_.upper_bound(start);
+    if (it != index_.begin() && std::prev(it)->second->end > start) it = std::prev(it);
+    while (it != index_.end() && it->second->start < end) {
+        Region* r = (it++)->second;
+        unindex_locked(r);
+        if (r->refs == 0) free_locked(r);
+    }
+}
+
+UcxRegCache::Stats UcxRegCache::stats() const {
+    std::lock_guard<std::mutex> lock(mu_);
+    Stats st;
+    st.hits = hits_;
+    st.misses = misses_;
+    st.evictions = evictions_;
+    st.pinned_bytes = pinned_;
+    st.regions = index_.size();
+    return st;
+}
+
+void UcxRegCache::unindex_locked(Region* region) {
+    if (region->idle) {
+        lru_.erase(region->lru_it);
+        region->idle = false;
+    }
+    if (region->indexed) {
+        index_.erase(region->start);
+        region->indexed = false;
+    }
+}
+
+void UcxRegCache::free_locked(Region* region) {
+    ucp_mem_unmap(ctx_, region->memh);
+    pinned_ -= region->end - region->start;
+    delete region;
+}
+
+void UcxRegCache::evict_locked() {
+    while (pinned_ > max_pinned_ && !lru_.empty()) {
+        Region* r = lru_.front();
+        unindex_locked(r);
+        free_locked(r);
+        ++evictions_;
+    }
+}
+
+UcxMem::UcxMem(ucp_context_h ctx, void* base, size_t len, unsigned prot)
     : base_(base), len_(len), ctx_(ctx) {
     ucp_mem_map_params_t mpar{};
     mpar.field_mask = UCP_MEM_MAP_PARAM_FIELD_ADDRESS | UCP_MEM_MAP_PARAM_FIELD_LENGTH;
     mpar.address = base_;
     mpar.length = len_;
+    if (prot) {
+        mpar.field_mask |= UCP_MEM_MAP_PARAM_FIELD_PROT;
+        mpar.prot = prot;
+    }
     if (ucp_mem_map(ctx_, &mpar, &memh_) != UCS_OK) throw std::runtime_error("ucp_mem_map failed");
 }
 
+UcxMem::UcxMem(UcxRegCache& cache, void* base, size_t len)
+    : base_(base), len_(len), ctx_(cache.ctx()), cache_(&cache) {
+    region_ = cache.acquire(base, len);
+    memh_ = UcxRegCache::memh(region_);
+}
+
 UcxMem::~UcxMem() {
-    if (memh_) ucp_mem_unmap(ctx_, memh_);
+    release();
+}
+
+void UcxMem::release() {
+    if (cache_) cache_->release(region_);
+    else if (memh_) ucp_mem_unmap(ctx_, memh_);
 }
 
 UcxMem::UcxMem(UcxMem&& other) noexcept {
@@ -170,14 +712,19 @@ UcxMem::UcxMem(UcxMem&& other) noexcept {
 
 UcxMem& UcxMem::operator=(UcxMem&& other) noexcept {
     if (this != &other) {
+        release(); // the registration this object held until now
         base_ = other.base_;
         len_ = other.len_;
         memh_ = other.memh_;
         ctx_ = other.ctx_;
+        cache_ = other.cache_;
+        region_ = other.region_;
         other.base_ = nullptr;
         other.len_ = 0;
         other.memh_ = nullptr;
         other.ctx_ = nullptr;
+        other.cache_ = nullptr;
+        other.region_ = nullptr;
     }
     return *this;
 }
@@ -192,7 +739,8 @@ std::vector<char> UcxMem::pack_rkey(ucp_context_h ctx) const {
     return out;
 }
 
-UcxEndpoint::UcxEndpoint(ucp_worker_h worker, const std::vector<char>& remote_addr_bytes) {
+UcxEndpoint::UcxEndpoint(ucp_worker_h worker, const std::vector<char>& remote_addr_bytes)
+    : worker_(worker) {
     ucp_ep_params_t ep_params{};
     ep_params.field_mask = UCP_EP_PARAM_FIELD_REMOTE_ADDRESS;
     ep_params.address = (ucp_address_t*)remote_addr_bytes.data();
@@ -200,18 +748,35 @@ UcxEndpoint::UcxEndpoint(ucp_worker_h worker, const std::vector<char>& remote_ad
 }
 
 UcxEndpoint::~UcxEndpoint() {
-    if (ep_) ucp_ep_destroy(ep_);
+    close();
 }
 
 UcxEndpoint::UcxEndpoint(UcxEndpoint&& other) noexcept { *this = std::move(other); }
 UcxEndpoint& UcxEndpoint::operator=(UcxEndpoint&& other) noexcept {
     if (this != &other) {
+        close();
         ep_ = other.ep_;
+        worker_ = other.worker_;
+        rkeys_ = std::move(other.rkeys_);
+        retired_rkeys_ = std::move(other.retired_rkeys_);
         other.ep_ = nullptr;
+        other.worker_ = nullptr;
+        other.rkeys_.clear();
+        other.retired_rkeys_.clear();
     }
     return *this;
 }
 
+void UcxEndpoint::close() {
+    // Cached rkeys belong to this endpoint and must go before it.
+    for (auto& kv : rkeys_) ucp_rkey_destroy(kv.second.rkey);
+    for (ucp_rkey_h rkey : retired_rkeys_) ucp_rkey_destroy(rkey);
+    rkeys_.clear();
+    retired_rkeys_.clear();
+    if (ep_) ucp_ep_destroy(ep_);
+    ep_ = nullptr;
+}
+
 ucp_rkey_h UcxEndpoint::import_rkey(const std::vector<char>& rkey_bytes) const {
     ucp_rkey_h rkey = nullptr;
     if (ucp_ep_rkey_unpack(ep_, (void*)rkey_bytes.data(), &rkey) != UCS_OK) throw std::runtime_error("ucp_ep_rkey_unpack failed");
@@ -222,6 +787,29 @@ void UcxEndpoint::destroy_rkey(ucp_rkey_h rkey) {
     if (rkey) ucp_rkey_destroy(rkey);
 }
 
+static uint64_t fnv1a64(const char* p, size_t len) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < len; ++i) {
+        h ^= static_cast<unsigned char>(p[i]);
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+ucp_rkey_h UcxEndpoint::cached_rkey(uint64_t region_id, const std::vector<char>& rkey_bytes) {
+    RkeyKey key{region_id, fnv1a64(rkey_bytes.data(), rkey_bytes.size())};
+    auto it = rkeys_.find(key);
+    if (it != rkeys_.end()) {
+        if (it->second.packed == rkey_bytes) return it->second.rkey;
+        // Hash collision: the old handle may still be in use, keep it until close.
+        retired_rkeys_.push_back(it->second.rkey);
+        rkeys_.erase(it);
+    }
+    ucp_rkey_h rkey = import_rkey(rkey_bytes);
+    rkeys_.emplace(key, RkeyEntry{rkey_bytes, rkey});
+    return rkey;
+}
+
 void* UcxEndpoint::put_nbx(const void* laddr, size_t len, uint64_t raddr, ucp_rkey_h rkey, const ucp_request_param_t* param) const {
     return ucp_put_nbx(ep_, laddr, len, raddr, rkey, param);
 }
@@ -233,3 +821,246 @@ void* UcxEndpoint::get_nbx(void* laddr, size_t len, uint64_t raddr, ucp_rkey_h r
 void* UcxEndpoint::flush_nbx(const ucp_request_param_t* param) const {
     return ucp_ep_flush_nbx(ep_, param);
 }
+
+ucs_status_t UcxEndpoint::fence() const {
+    return ucp_worker_fence(worker_);
+}
+
+const unsigned PutNotice::kAmId;
+
+PutNotifyReqs UcxEndpoint::put_notify_nbx(const void* laddr, size_t len, uint64_t raddr, ucp_rkey_h rkey,
+                                          uint32_t region, uint64_t offset, const ucp_request_param_t* param) const {
+    PutNotifyReqs reqs;
+    reqs.put = ucp_put_nbx(ep_, laddr, len, raddr, rkey, param);
+    if (UCS_PTR_IS_ERR(reqs.put)) return reqs;
+    ucs_status_t st = ucp_worker_fence(worker_);
+    if (st != UCS_OK) {
+        reqs.notice = UCS_STATUS_PTR(st);
+        return reqs;
+    }
+
+    PutNotice n;
+    n.region = region;
+    n.offset = offset;
+    n.len = len;
+    ucp_request_param_t p{};
+    if (param) p = *param;
+    p.op_attr_mask &= ~static_cast<uint32_t>(UCP_OP_ATTR_FIELD_MEMH); // memh describes laddr, not the notice
+    p.op_attr_mask |= UCP_OP_ATTR_FIELD_FLAGS;
+    p.flags |= UCP_AM_SEND_FLAG_COPY_HEADER; // n lives on this stack frame
+    reqs.notice = ucp_am_send_nbx(ep_, PutNotice::kAmId, &n, sizeof(n), nullptr, 0, &p);
+    return reqs;
+}
+
+void* UcxEndpoint::atomic_nbx(ucp_atomic_op_t op, const void* value, size_t width, uint64_t raddr,
+                              ucp_rkey_h rkey, void* result, const ucp_request_param_t* param) const {
+    ucp_request_param_t p{};
+    if (param) p = *param;
+    p.op_attr_mask |= UCP_OP_ATTR_FIELD_DATATYPE;
+    p.datatype = ucp_dt_make_contig(width);
+    if (result) {
+        p.op_attr_mask |= UCP_OP_ATTR_FIELD_REPLY_BUFFER;
+        p.reply_buffer = result;
+    }
+    return ucp_atomic_op_nbx(ep_, op, value, 1, raddr, rkey, &p);
+}
+
+namespace {
+
+// Completion state shared by every request of one batch.
+struct BatchState {
+    size_t pending{0};
+    ucs_status_t status{UCS_OK};
+};
+
+void batch_send_cb(void* request, ucs_status_t status, void* user_data) {
+    auto* batch = static_cast<BatchState*>(user_data);
+    if (status != UCS_OK && batch->status == UCS_OK) batch->status = status;
+    --batch->pending;
+    ucp_request_free(request);
+}
+
+// Accounts for the return value of an NBX call posted with batch_send_cb.
+bool batch_track(BatchState& batch, void* req) {
+    if (req == nullptr) return true; // completed in place
+    if (UCS_PTR_IS_ERR(req)) {
+        if (batch.status == UCS_OK) batch.status = UCS_PTR_STATUS(req);
+        return false;
+    }
+    ++batch.pending;
+    return true;
+}
+
+} // namespace
+
+ucs_status_t UcxEndpoint::put_batch(const std::vector<RmaOp>& ops, ucp_mem_h memh) const {
+    return run_batch(true, ops, memh);
+}
+
+ucs_status_t UcxEndpoint::get_batch(const std::vector<RmaOp>& ops, ucp_mem_h memh) const {
+    return run_batch(false, ops, memh);
+}
+
+ucs_status_t UcxEndpoint::run_batch(bool is_put, const std::vector<RmaOp>& ops, ucp_mem_h memh) const {
+    BatchState batch;
+    ucp_request_param_t param{};
+    param.op_attr_mask = UCP_OP_ATTR_FIELD_CALLBACK | UCP_OP_ATTR_FIELD_USER_DATA;
+    param.cb.send = batch_send_cb;
+    param.user_data = &batch;
+    ucp_request_param_t flush_param = param;
+    if (memh) {
+        param.op_attr_mask |= UCP_OP_ATTR_FIELD_MEMH;
+        param.memh = memh;
+    }
+
+    for (const RmaOp& op : ops) {
+        void* req = is_put ? ucp_put_nbx(ep_, op.laddr, op.len, op.raddr, op.rkey, &param)
+                           : ucp_get_nbx(ep_, op.laddr, op.len, op.raddr, op.rkey, &param);
+        if (!batch_track(batch, req)) break;
+    }
+    batch_track(batch, ucp_ep_flush_nbx(ep_, &flush_param));
+
+    while (batch.pending > 0) ucp_worker_progress(worker_);
+    return batch.status;
+}
+
+void UcxNotifyDispatcher::on(uint32_t region, size_t size, Handler handler) {
+    regions_[region] = Entry{size, std::move(handler)};
+}
+
+void UcxNotifyDispatcher::attach(ucp_worker_h worker) {
+    ucp_am_handler_param_t p{};
+    p.field_mask = UCP_AM_HANDLER_PARAM_FIELD_ID | UCP_AM_HANDLER_PARAM_FIELD_CB | UCP_AM_HANDLER_PARAM_FIELD_ARG;
+    p.id = PutNotice::kAmId;
+    p.cb = &UcxNotifyDispatcher::am_cb;
+    p.arg = this;
+    if (ucp_worker_set_am_recv_handler(worker, &p) != UCS_OK)
+        throw std::runtime_error("ucp_worker_set_am_recv_handler failed");
+}
+
+UcxNotifyDispatcher::Stats UcxNotifyDispatcher::stats() const {
+    Stats s;
+    s.notices = notices_.load(std::memory_order_relaxed);
+    s.bytes = bytes_.load(std::memory_order_relaxed);
+    s.rejected = rejected_.load(std::memory_order_relaxed);
+    return s;
+}
+
+ucs_status_t UcxNotifyDispatcher::am_cb(void* arg, const void* header, size_t header_len, void*, size_t,
+                                        const ucp_am_recv_param_t*) {
+    auto* self = static_cast<UcxNotifyDispatcher*>(arg);
+    if (header_len != sizeof(PutNotice)) {
+        self->rejected_.fetch_add(1, std::memory_order_relaxed);
+        return UCS_OK;
+    }
+    PutNotice n;
+    std::memcpy(&n, header, sizeof(n)); // header alignment is not guaranteed
+    self->dispatch(n);
+    return UCS_OK; // nothing retained
+}
+
+void UcxNotifyDispatcher::dispatch(const PutNotice& n) {
+    auto it = regions_.find(n.region);
+    if (it == regions_.end() || n.offset > it->second.size || n.len > it->second.size - n.offset) {
+        rejected_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    notices_.fetch_add(1, std::memory_order_relaxed);
+    bytes_.fetch_add(n.len, std::memory_order_relaxed);
+    if (it->second.handler) it->second.handler(n);
+}
+
+UcxCompletionEngine::UcxCompletionEngine(const UcxEnv& env) : worker_(env.worker()) {}
+
+ucp_request_param_t UcxCompletionEngine::param(const ucp_request_param_t* base) const {
+    ucp_request_param_t p{};
+    if (base) p = *base;
+    p.op_attr_mask |= UCP_OP_ATTR_FIELD_CALLBACK | UCP_OP_ATTR_FIELD_USER_DATA;
+    p.cb.send = send_cb;
+    p.user_data = const_cast<UcxCompletionEngine*>(this);
+    return p;
+}
+
+void UcxCompletionEngine::send_cb(void* request, ucs_status_t status, void* user_data) {
+    auto* engine = static_cast<UcxCompletionEngine*>(user_data);
+    auto* state = static_cast<UcxRequestState*>(request);
+    engine->queue_.push_back(UcxCompletion{state->id, status});
+    --engine->pending_;
+    state->id = 0; // request objects are recycled without another request_init
+    ucp_request_free(request);
+}
+
+uint64_t UcxCompletionEngine::submit(void* req) {
+    uint64_t id = next_id_++;
+    if (req == nullptr) {
+        queue_.push_back(UcxCompletion{id, UCS_OK});
+    } else if (UCS_PTR_IS_ERR(req)) {
+        queue_.push_back(UcxCompletion{id, UCS_PTR_STATUS(req)});
+    } else {
+        // The callback can only run from progress, i.e. after this point.
+        static_cast<UcxRequestState*>(req)->id = id;
+        ++pending_;
+    }
+    return id;
+}
+
+unsigned UcxCompletionEngine::progress() const {
+    return ucp_worker_progress(worker_);
+}
+
+bool UcxCompletionEngine::poll(UcxCompletion& out) {
+    if (queue_.empty()) return false;
+    out = queue_.front();
+    queue_.pop_front();
+    return true;
+}
+
+bool UcxCompletionEngine::take(uint64_t id, UcxCompletion& out) {
+    for (auto it = queue_.begin(); it != queue_.end(); ++it) {
+        if (it->id == id) {
+            out = *it;
+            queue_.erase(it);
+            return true;
+        }
+    }
+    return false;
+}
+
+UcxCompletion UcxCompletionEngine::wait_any(const std::vector<uint64_t>& ids) {
+    if (ids.empty()) throw std::invalid_argument("wait_any: empty id set");
+    UcxCompletion c{};
+    while (true) {
+        for (uint64_t id : ids)
+            if (take(id, c)) return c;
+        if (pending_ == 0) throw std::logic_error("wait_any: ids are neither pending nor queued");
+        ucp_worker_progress(worker_);
+    }
+}
+
+ucs_status_t UcxCompletionEngine::wait_all(const std::vector<uint64_t>& ids) {
+    ucs_status_t first_err = UCS_OK;
+    size_t done = 0;
+    std::vector<bool> seen(ids.size(), false);
+    while (done < ids.size()) {
+        UcxCompletion c{};
+        for (size_t i = 0; i < ids.size(); ++i) {
+            if (seen[i] || !take(ids[i], c)) continue;
+            seen[i] = true;
+            ++done;
+            if (c.status != UCS_OK && first_err == UCS_OK) first_err = c.status;
+        }
+        if (done == ids.size()) break;
+        if (pending_ == 0) throw std::logic_error("wait_all: ids are neither pending nor queued");
+        ucp_worker_progress(worker_);
+    }
+    return first_err;
+}
+
+ucs_status_t UcxCompletionEngine::drain() {
+    while (pending_ > 0) ucp_worker_progress(worker_);
+    ucs_status_t first_err = UCS_OK;
+    for (const UcxCompletion& c : queue_)
+        if (c.status != UCS_OK && first_err == UCS_OK) first_err = c.status;
+    queue_.clear();
+    return first_err;
+}
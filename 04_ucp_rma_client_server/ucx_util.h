@@ -5,9 +5,19 @@
 
 #include <ucp/api/ucp.h>
 
+#include <sys/uio.h>
+
+#include <atomic>
 #include <cstdint>
+#include <deque>
+#include <functional>
+#include <list>
+#include <map>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 #include <string>
+#include <type_traits>
 
 // TCP helpers
 namespace tcp {
@@ -16,27 +26,75 @@ int accept_nonblock(int lfd); // returns -1 if no pending
 int connect(const char* ip, uint16_t port);
 void send_all(int fd, const void* buf, size_t len);
 void recv_all(int fd, void* buf, size_t len);
+void writev_all(int fd, struct iovec* iov, int iovcnt); // retries partial writes
+}
+
+// Command-line helpers shared by the demo binaries
+namespace cli {
+const char* opt_value(const char* arg, const char* name); // "--name=value" -> value, else nullptr
+bool is_flag(const char* arg, const char* name);          // exactly "--name"
+size_t parse_size(const char* s);                         // bytes with optional K/M/G suffix
+std::vector<size_t> parse_size_list(const char* s);       // "8,4K,1M" -> sizes, throws on bad items
 }
 
+// CRC32C (Castagnoli). Pass 0 to start; feed the result back to continue.
+// Uses the SSE4.2 crc32 instruction (three interleaved streams) when the CPU
+// has it, a table-driven loop otherwise.
+uint32_t crc32c(uint32_t crc, const void* data, size_t len);
+const char* crc32c_impl(); // "sse4.2" or "software"
+
+// One registered server region as published in the handshake.
+struct RegionDesc {
+    uint32_t id{0};
+    uint64_t remote_addr{0}; // region virtual address on the server
+    uint64_t size{0};        // bytes in region
+    std::vector<char> rkey;  // bytes from ucp_rkey_pack
+};
+
 struct Handshake {
-    std::vector<char> worker_addr; // bytes of ucp_address_t
-    std::vector<char> rkey;        // bytes from ucp_rkey_pack
-    uint64_t remote_addr{0};       // server buffer virtual address
-    uint64_t size{0};              // bytes in buffer
-
-    // Wire format (native endianness for simplicity on homogeneous envs):
-    // [u32 wlen][waddr][u32 rlen][rkey][u64 raddr][u64 size]
-    void send_fd(int fd) const;
-    static Handshake recv_fd(int fd);
+    std::vector<char> worker_addr;  // bytes of ucp_address_t
+    std::vector<RegionDesc> regions; // region table, one entry per registered region
+
+    // Returns the region with the given id; throws if the server has none.
+    const RegionDesc& region(uint32_t id) const;
+
+    // Wire format v2, all integers little-endian:
+    // header  [u32 magic "UCXH"][u16 version][u16 header_len][u32 payload_len][u32 crc32c(payload)]
+    // payload [u32 wlen][waddr][u32 nregions]
+    //         nregions x [u32 id][u64 raddr][u64 size][u32 rlen][rkey]
+    static const uint32_t kMagic = 0x48584355u; // "UCXH" on the wire
+    static const uint16_t kVersion = 2;
+    static const size_t kHeaderLen = 16;
+
+    std::vector<char> serialize() const;
+    static Handshake deserialize(const char* data, size_t len); // throws on bad frame
+
+    void send_fd(int fd) const;                                  // one writev for header + payload
+    static void send_blob(int fd, const std::vector<char>& blob); // pre-serialized frame
+    static Handshake recv_fd(int fd);                             // one buffered read in the common case
+};
+
+// Construction options for UcxEnv.
+struct UcxEnvOptions {
+    ucs_thread_mode_t thread_mode{UCS_THREAD_MODE_MULTI};
+    bool wakeup{false}; // enable UCP_FEATURE_WAKEUP so event_fd()/arm() can be used
+    bool mt_workers_shared{false}; // context will host workers driven by different threads
 };
 
 // UcxEnv:
 // - RAII wrapper that initializes and owns a UCP context and worker.
 // - Provides helper utilities for obtaining worker address bytes, progressing
 //   the worker, and waiting for NBX requests to complete.
+// - With options.wakeup the worker's event fd can be armed and waited on
+//   (epoll/poll) instead of busy progressing.
+// - A child UcxEnv adds another worker on the parent's context (e.g. one
+//   SINGLE-mode worker per thread). Memory registered through the parent is
+//   usable from every worker; the parent must outlive its children.
 class UcxEnv {
 public:
-    UcxEnv();
+    UcxEnv() : UcxEnv(UcxEnvOptions()) {}
+    explicit UcxEnv(const UcxEnvOptions& opts);
+    UcxEnv(const UcxEnv& parent, const UcxEnvOptions& opts); // worker on parent's context
     ~UcxEnv();
     UcxEnv(const UcxEnv&) = delete;
     UcxEnv& operator=(const UcxEnv&) = delete;
@@ -48,21 +106,91 @@ public:
     std::vector<char> worker_address_bytes() const;
 
     // Progress and wait helpers
-    void progress() const;
+    unsigned progress() const; // returns the number of events processed
     ucs_status_t wait(void* req) const; // polls until complete and frees
 
+    // Event-driven progress (requires options.wakeup). arm() returns UCS_OK when
+    // it is safe to block on event_fd(), UCS_ERR_BUSY when progress is needed.
+    int event_fd() const;
+    ucs_status_t arm() const;
+
 private:
+    void create_worker(const UcxEnvOptions& opts);
+
     ucp_context_h ctx_{nullptr};
     ucp_worker_h worker_{nullptr};
+    bool owns_ctx_{true};
+};
+
+// UcxRegCache:
+// - Pin-down cache for ucp_mem_map registrations keyed by page-aligned address
+//   range. Cached ranges are kept disjoint in an ordered map (a request that
+//   overlaps cached ranges is merged into one registration, like ucs_rcache),
+//   so a covered lookup is a single O(log n) search with no syscall.
+// - Idle registrations (no UcxMem referencing them) stay mapped on an LRU list
+//   and are unmapped oldest-first once pinned bytes exceed the cap.
+// - There are no memory hooks: callers must invalidate() ranges they free or
+//   remap. Must be destroyed before the owning context and after all UcxMem
+//   objects that reference it.
+class UcxRegCache {
+public:
+    struct Region;
+    struct Stats {
+        uint64_t hits{0};
+        uint64_t misses{0};
+        uint64_t evictions{0};
+        size_t pinned_bytes{0};
+        size_t regions{0};
+    };
+
+    UcxRegCache(ucp_context_h ctx, size_t max_pinned_bytes);
+    ~UcxRegCache();
+    UcxRegCache(const UcxRegCache&) = delete;
+    UcxRegCache& operator=(const UcxRegCache&) = delete;
+
+    ucp_context_h ctx() const { return ctx_; }
+
+    // Returns a referenced region covering [base, base+len), registering on miss.
+    Region* acquire(void* base, size_t len);
+    void release(Region* region);
+    static ucp_mem_h memh(const Region* region);
+
+    // Drops cached registrations overlapping [base, base+len). In-use regions are
+    // unmapped when their last reference is released.
+    void invalidate(void* base, size_t len);
+
+    Stats stats() const;
+
+private:
+    void unindex_locked(Region* region);
+    void free_locked(Region* region);
+    void evict_locked();
+
+    ucp_context_h ctx_{nullptr};
+    size_t max_pinned_{0};
+    size_t pinned_{0};
+    uint64_t hits_{0};
+    uint64_t misses_{0};
+    uint64_t evictions_{0};
+    std::map<uintptr_t, Region*> index_; // start -> region, disjoint ranges
+    std::list<Region*> lru_;             // idle indexed regions, oldest first
+    mutable std::mutex mu_;
 };
 
 // UcxMem:
 // - RAII wrapper for ucp_mem_map/unmap on a user-provided host buffer.
 // - Exposes packed rkey bytes via pack_rkey for sending to a remote peer.
+// - When built from a UcxRegCache it borrows a cached registration instead of
+//   mapping, and returns it to the cache on destruction.
+// - prot restricts the registration (UCP_MEM_MAP_PROT_* mask, 0 = UCX default
+//   read/write); read-only mappings such as PROT_READ file maps need kReadOnly.
 class UcxMem {
 public:
+    static const unsigned kReadOnly = UCP_MEM_MAP_PROT_LOCAL_READ | UCP_MEM_MAP_PROT_REMOTE_READ;
+
     UcxMem() = default;
-    UcxMem(ucp_context_h ctx, void* base, size_t len);
+    UcxMem(ucp_context_h ctx, void* base, size_t len, unsigned prot = 0);
+    UcxMem(UcxRegCache& cache, void* base, size_t len);
     ~UcxMem();
     UcxMem(const UcxMem&) = delete;
     UcxMem& operator=(const UcxMem&) = delete;
@@ -76,16 +204,55 @@ public:
     std::vector<char> pack_rkey(ucp_context_h ctx) const;
 
 private:
+    void release(); // unmaps, or returns a cached registration to its cache
+
     void* base_{nullptr};
     size_t len_{0};
     ucp_mem_h memh_{nullptr};
     ucp_context_h ctx_{nullptr};
+    UcxRegCache* cache_{nullptr};
+    UcxRegCache::Region* region_{nullptr};
+};
+
+// One scattered RMA transfer for the batch API: len bytes between local laddr
+// and remote raddr (covered by rkey).
+struct RmaOp {
+    void* laddr{nullptr};
+    uint64_t raddr{0};
+    size_t len{0};
+    ucp_rkey_h rkey{nullptr};
+};
+
+// Header of the active message sent by UcxEndpoint::put_notify_nbx: bytes
+// [offset, offset+len) of the peer's region `region` have been written.
+struct PutNotice {
+    static const unsigned kAmId = 1;
+
+    uint32_t region{0};
+    uint32_t reserved{0};
+    uint64_t offset{0};
+    uint64_t len{0};
+};
+
+// Requests posted by UcxEndpoint::put_notify_nbx. Each is a request handle,
+// NULL (completed in place) or an error pointer; both must be checked or
+// handed to a completion engine.
+struct PutNotifyReqs {
+    void* put{nullptr};    // the data put; an error here means no notice was sent
+    void* notice{nullptr}; // the PutNotice AM
 };
 
 // UcxEndpoint:
 // - RAII wrapper for a UCP endpoint to a remote worker address.
 // - Provides rkey import/destroy helpers and thin wrappers around NBX
 //   RMA operations (put/get) and endpoint flush.
+// - Batch helpers post many RMA ops back-to-back and complete them with a
+//   single flush and one progress loop.
+// - Keeps a cache of imported rkeys keyed by (remote region id, packed-rkey
+//   hash); cached rkeys are owned by the endpoint and destroyed on close.
+// - Remote atomics (fetch-add, swap, compare-and-swap) on 32/64-bit words.
+// - Put-with-notify: a put followed by a PutNotice active message, so the
+//   peer reacts to the write without polling its buffer.
 class UcxEndpoint {
 public:
     UcxEndpoint() = default;
@@ -98,16 +265,201 @@ public:
 
     bool valid() const { return ep_ != nullptr; }
     ucp_ep_h ep() const { return ep_; }
+    ucp_worker_h worker() const { return worker_; }
 
     // Rkey import/destroy
     ucp_rkey_h import_rkey(const std::vector<char>& rkey_bytes) const;
     static void destroy_rkey(ucp_rkey_h rkey);
 
+    // Cached import: unpacks rkey_bytes on first use for region_id and returns
+    // the same ucp_rkey_h afterwards without calling ucp_ep_rkey_unpack. The
+    // endpoint owns the result; do not pass it to destroy_rkey. Not thread-safe.
+    ucp_rkey_h cached_rkey(uint64_t region_id, const std::vector<char>& rkey_bytes);
+    size_t cached_rkey_count() const { return rkeys_.size(); }
+
     // RMA ops using NBX; param.memh must be set by caller if needed
     void* put_nbx(const void* laddr, size_t len, uint64_t raddr, ucp_rkey_h rkey, const ucp_request_param_t* param) const;
     void* get_nbx(void* laddr, size_t len, uint64_t raddr, ucp_rkey_h rkey, const ucp_request_param_t* param) const;
     void* flush_nbx(const ucp_request_param_t* param) const;
+    // Orders RMA/atomic ops issued on this worker before the call ahead of
+    // later ones (ucp_worker_fence); cheaper than a flush, no completion wait.
+    ucs_status_t fence() const;
+    // Put, ucp_worker_fence, then a PutNotice AM for [offset, offset+len) of
+    // the peer's region `region` (raddr is that range's remote address).
+    // param (callback, user_data, memh) applies to the put; the notice gets the
+    // same callback without the memh. The fence only orders the two: the notice
+    // can complete successfully even if the put later fails, so the write is
+    // done only once both requests completed with UCS_OK. laddr must stay
+    // valid until the put completes.
+    PutNotifyReqs put_notify_nbx(const void* laddr, size_t len, uint64_t raddr, ucp_rkey_h rkey, uint32_t region,
+                                 uint64_t offset, const ucp_request_param_t* param) const;
+
+    // Remote atomic on a naturally aligned 4- or 8-byte word at raddr. The
+    // operand is copied at post time. If result is non-null the old remote
+    // value is written there on completion (for CSWAP it must hold the compare
+    // value on entry). param may be null.
+    void* atomic_nbx(ucp_atomic_op_t op, const void* value, size_t width, uint64_t raddr, ucp_rkey_h rkey,
+                     void* result, const ucp_request_param_t* param) const;
+
+    // Typed atomics for uint32_t/uint64_t. Fetching variants store the previous
+    // remote value in *result, which must stay valid until completion.
+    template <typename T>
+    void* add_nbx(T value, uint64_t raddr, ucp_rkey_h rkey, const ucp_request_param_t* param = nullptr) const {
+        check_atomic_type<T>();
+        return atomic_nbx(UCP_ATOMIC_OP_ADD, &value, sizeof(T), raddr, rkey, nullptr, param);
+    }
+    template <typename T>
+    void* fetch_add_nbx(T value, T* result, uint64_t raddr, ucp_rkey_h rkey,
+                        const ucp_request_param_t* param = nullptr) const {
+        check_atomic_type<T>();
+        return atomic_nbx(UCP_ATOMIC_OP_ADD, &value, sizeof(T), raddr, rkey, result, param);
+    }
+    template <typename T>
+    void* swap_nbx(T value, T* result, uint64_t raddr, ucp_rkey_h rkey, const ucp_request_param_t* param = nullptr) const {
+        check_atomic_type<T>();
+        return atomic_nbx(UCP_ATOMIC_OP_SWAP, &value, sizeof(T), raddr, rkey, result, param);
+    }
+    // Stores `desired` iff the remote word equals `expected`; *result receives
+    // the previous remote value, so the swap happened iff *result == expected.
+    template <typename T>
+    void* compare_swap_nbx(T expected, T desired, T* result, uint64_t raddr, ucp_rkey_h rkey,
+                           const ucp_request_param_t* param = nullptr) const {
+        check_atomic_type<T>();
+        *result = expected;
+        return atomic_nbx(UCP_ATOMIC_OP_CSWAP, &desired, sizeof(T), raddr, rkey, result, param);
+    }
+
+    // Batched RMA: posts all ops back-to-back, counts outstanding requests in one
+    // shared counter, then issues a single flush and progresses the worker until
+    // the batch drains. memh (optional) must cover every laddr. Returns the first
+    // error seen; posting stops at the first failed op.
+    ucs_status_t put_batch(const std::vector<RmaOp>& ops, ucp_mem_h memh = nullptr) const;
+    ucs_status_t get_batch(const std::vector<RmaOp>& ops, ucp_mem_h memh = nullptr) const;
 
 private:
+    template <typename T>
+    static void check_atomic_type() {
+        static_assert(std::is_same<T, uint32_t>::value || std::is_same<T, uint64_t>::value,
+                      "UCX atomics operate on uint32_t or uint64_t");
+    }
+    ucs_status_t run_batch(bool is_put, const std::vector<RmaOp>& ops, ucp_mem_h memh) const;
+    void close();
+
+    struct RkeyKey {
+        uint64_t region_id;
+        uint64_t hash; // FNV-1a of the packed rkey bytes
+        bool operator==(const RkeyKey& o) const { return region_id == o.region_id && hash == o.hash; }
+    };
+    struct RkeyKeyHash {
+        size_t operator()(const RkeyKey& k) const { return static_cast<size_t>(k.hash ^ (k.region_id * 0x9e3779b97f4a7c15ull)); }
+    };
+    struct RkeyEntry {
+        std::vector<char> packed;
+        ucp_rkey_h rkey;
+    };
+
     ucp_ep_h ep_{nullptr};
+    ucp_worker_h worker_{nullptr};
+    std::unordered_map<RkeyKey, RkeyEntry, RkeyKeyHash> rkeys_;
+    std::vector<ucp_rkey_h> retired_rkeys_; // replaced on hash collision, freed on close
+};
+
+// UcxNotifyDispatcher:
+// - Receives PutNotice active messages on the workers it is attached to and
+//   calls the handler registered for the notice's region, from inside
+//   ucp_worker_progress on the thread progressing that worker.
+// - Notices for unknown regions or ranges past the region end are dropped and
+//   counted as rejected.
+// - Register regions with on() before attach(); handlers must be thread-safe
+//   when attached workers are progressed by different threads. Must outlive
+//   the attached workers (it is their AM callback argument).
+class UcxNotifyDispatcher {
+public:
+    using Handler = std::function<void(const PutNotice&)>;
+
+    struct Stats {
+        uint64_t notices;
+        uint64_t bytes;
+        uint64_t rejected;
+    };
+
+    UcxNotifyDispatcher() = default;
+    UcxNotifyDispatcher(const UcxNotifyDispatcher&) = delete;
+    UcxNotifyDispatcher& operator=(const UcxNotifyDispatcher&) = delete;
+
+    void on(uint32_t region, size_t size, Handler handler);
+    void attach(ucp_worker_h worker);
+    Stats stats() const;
+
+private:
+    struct Entry {
+        size_t size;
+        Handler handler;
+    };
+
+    static ucs_status_t am_cb(void* arg, const void* header, size_t header_len, void* data, size_t len,
+                              const ucp_am_recv_param_t* param);
+    void dispatch(const PutNotice& n);
+
+    std::unordered_map<uint32_t, Entry> regions_;
+    std::atomic<uint64_t> notices_{0};
+    std::atomic<uint64_t> bytes_{0};
+    std::atomic<uint64_t> rejected_{0};
+};
+
+// State embedded in every UCX request of a UcxEnv context via request_size /
+// request_init, used by UcxCompletionEngine to map a request back to its op.
+struct UcxRequestState {
+    uint64_t id;
+};
+
+// One finished operation delivered by UcxCompletionEngine.
+struct UcxCompletion {
+    uint64_t id;
+    ucs_status_t status;
+};
+
+// UcxCompletionEngine:
+// - Callback-based completion tracking for NBX operations on one worker.
+//   param() sets cb.send/user_data; the callback stores the result under the
+//   op id kept in the request's embedded UcxRequestState and appends it to a
+//   completion queue, then frees the request.
+// - Callers submit() the return value of each NBX call and then poll() the
+//   queue or wait_any()/wait_all() on a set of ids; all of these share one
+//   progress loop instead of spinning per request.
+// - Single-threaded: submission and progress must happen on the same thread.
+class UcxCompletionEngine {
+public:
+    explicit UcxCompletionEngine(const UcxEnv& env);
+    UcxCompletionEngine(const UcxCompletionEngine&) = delete;
+    UcxCompletionEngine& operator=(const UcxCompletionEngine&) = delete;
+
+    // Request params for an NBX call tracked by this engine: a copy of `base`
+    // (memh, datatype, ...) with the completion callback added.
+    ucp_request_param_t param(const ucp_request_param_t* base = nullptr) const;
+
+    // Records the result of an NBX call issued with param() and returns its op
+    // id. Immediate completions and posting errors are queued right away.
+    uint64_t submit(void* req);
+
+    size_t pending() const { return pending_; } // requests still in flight
+    unsigned progress() const;
+
+    // Pops the oldest queued completion; false if the queue is empty.
+    bool poll(UcxCompletion& out);
+    // Progresses until one of `ids` completes and removes it from the queue.
+    UcxCompletion wait_any(const std::vector<uint64_t>& ids);
+    // Progresses until all `ids` complete; returns the first error, if any.
+    ucs_status_t wait_all(const std::vector<uint64_t>& ids);
+    // Waits for every outstanding request and empties the queue.
+    ucs_status_t drain();
+
+private:
+    static void send_cb(void* request, ucs_status_t status, void* user_data);
+    bool take(uint64_t id, UcxCompletion& out);
+
+    ucp_worker_h worker_{nullptr};
+    uint64_t next_id_{1};
+    size_t pending_{0};
+    std::deque<UcxCompletion> queue_;
 };
@@ -0,0 +1,96 @@
+#include "ucx_verify.h"
+#include "ucx_util.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+const uint32_t DigestRequest::kMagic;
+const size_t DigestRequest::kWireLen;
+
+namespace {
+
+const size_t kDigestSliceBytes = size_t(64) << 20; // auto threads: one per 64 MiB
+
+void put_le(std::vector<char>& out, uint64_t v, size_t nbytes) {
+    for (size_t i = 0; i < nbytes; ++i) out.push_back(static_cast<char>(v >> (8 * i)));
+}
+
+uint64_t get_le(const char* p, size_t nbytes) {
+    uint64_t v = 0;
+    for (size_t i = 0; i < nbytes; ++i) v |= static_cast<uint64_t>(static_cast<unsigned char>(p[i])) << (8 * i);
+    return v;
+}
+
+} // namespace
+
+void DigestRequest::send_fd(int fd) const {
+    std::vector<char> out;
+    out.reserve(kWireLen);
+    put_le(out, kMagic, 4);
+    put_le(out, region, 4);
+    put_le(out, offset, 8);
+    put_le(out, len, 8);
+    put_le(out, chunk, 8);
+    tcp::send_all(fd, out.data(), out.size());
+}
+
+DigestRequest DigestRequest::deserialize(const char* frame) {
+    if (get_le(frame, 4) != kMagic) throw std::runtime_error("digest request: bad magic");
+    DigestRequest out;
+    out.region = static_cast<uint32_t>(get_le(frame + 4, 4));
+    out.offset = get_le(frame + 8, 8);
+    out.len = get_le(frame + 16, 8);
+    out.chunk = get_le(frame + 24, 8);
+    return out;
+}
+
+void DigestReply::send_fd(int fd) const {
+    std::vector<char> out;
+    out.reserve(12 + 4 * digests.size());
+    put_le(out, DigestRequest::kMagic, 4);
+    put_le(out, status, 4);
+    put_le(out, digests.size(), 4);
+    for (uint32_t d : digests) put_le(out, d, 4);
+    tcp::send_all(fd, out.data(), out.size());
+}
+
+DigestReply DigestReply::recv_fd(int fd) {
+    char hdr[12];
+    tcp::recv_all(fd, hdr, sizeof(hdr));
+    if (get_le(hdr, 4) != DigestRequest::kMagic) throw std::runtime_error("digest reply: bad magic");
+    DigestReply r;
+    r.status = static_cast<uint32_t>(get_le(hdr + 4, 4));
+    uint32_t count = static_cast<uint32_t>(get_le(hdr + 8, 4));
+    if (count > kMaxDigests) throw std::runtime_error("digest reply: too many digests");
+    std::vector<char> body(4 * static_cast<size_t>(count));
+    if (!body.empty()) tcp::recv_all(fd, body.data(), body.size());
+    r.digests.resize(count);
+    for (uint32_t i = 0; i < count; ++i) r.digests[i] = static_cast<uint32_t>(get_le(body.data() + 4 * i, 4));
+    return r;
+}
+
+std::vector<uint32_t> chunk_digests(const char* base, size_t len, size_t chunk, unsigned threads) {
+    if (chunk == 0) throw std::invalid_argument("chunk_digests: chunk must be > 0");
+    size_t nchunks = len / chunk + (len % chunk != 0); // no overflow for huge chunks
+    std::vector<uint32_t> out(nchunks);
+    if (threads == 0) {
+        unsigned ncpu = std::max(1u, std::thread::hardware_concurrency());
+        threads = static_cast<unsigned>(std::min<size_t>(ncpu, std::max<size_t>(1, len / kDigestSliceBytes)));
+    }
+    threads = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(threads, nchunks)));
+
+    // Contiguous runs of chunks per thread keep each thread streaming.
+    size_t per = (nchunks + threads - 1) / threads;
+    auto work = [&](size_t first) {
+        for (size_t c = first; c < std::min(nchunks, first + per); ++c) {
+            size_t off = c * chunk;
+            out[c] = crc32c(0, base + off, std::min(chunk, len - off));
+        }
+    };
+    std::vector<std::thread> pool;
+    for (size_t first = per; first < nchunks; first += per) pool.emplace_back(work, first);
+    work(0);
+    for (std::thread& t : pool) t.join();
+    return out;
+}
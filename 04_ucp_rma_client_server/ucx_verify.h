@@ -0,0 +1,44 @@
+// End-to-end integrity checks for RMA transfers.
+// - Both sides compute CRC32C per fixed-size chunk of a region (in parallel,
+//   hardware CRC32C where available) and compare digests over the TCP
+//   connection that carried the handshake.
+// - Wire format, little-endian:
+//   request [u32 magic "UCXV"][u32 region][u64 offset][u64 len][u64 chunk]
+//   reply   [u32 magic "UCXV"][u32 status][u32 count][count x u32 crc32c]
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct DigestRequest {
+    static const uint32_t kMagic = 0x56584355u; // "UCXV" on the wire
+    static const size_t kWireLen = 32;
+
+    uint32_t region{0};
+    uint64_t offset{0}; // byte range [offset, offset+len) of the region
+    uint64_t len{0};
+    uint64_t chunk{0};  // digest granularity; the last chunk may be short
+
+    void send_fd(int fd) const;
+    // Decodes one complete kWireLen-byte frame; throws on a bad magic. The
+    // server collects frames itself so a partial one never blocks it.
+    static DigestRequest deserialize(const char* frame);
+};
+
+struct DigestReply {
+    static const uint32_t kOk = 0;
+    static const uint32_t kBadRequest = 1; // unknown region, range or chunk size
+    static const uint32_t kMaxDigests = 1u << 26;
+
+    uint32_t status{kOk};
+    std::vector<uint32_t> digests;
+
+    void send_fd(int fd) const;
+    static DigestReply recv_fd(int fd); // throws on bad frame
+};
+
+// CRC32C of every `chunk`-sized piece of [base, base+len). threads == 0 picks
+// one thread per 64 MiB, up to the CPU count.
+std::vector<uint32_t> chunk_digests(const char* base, size_t len, size_t chunk, unsigned threads = 0);